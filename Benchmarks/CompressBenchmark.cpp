@@ -0,0 +1,276 @@
+// Microbenchmark for ParentBlock compression
+// compresses synthetic parent blocks with the runtime layout kernels and the ones specialised for their shape,
+// then reports time and cache misses per voxel for each
+// the vectorised run finders are checked against the scalar one on the same rows first
+// cache misses are read from Linux perf events and reported as unavailable elsewhere, including virtual machines without a PMU
+// the bytes of block list every voxel's lines take are reported too, which does not need counters and tracks cache traffic
+// to compare block layouts, build this file against each commit and run both, see the README
+//
+// usage: CompressBenchmark [parent block size] [voxels per size]
+// without a size the common cubes are measured, shapes without specialised kernels compare the runtime ones with themselves
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ParentBlock.h"
+#include "RunFinder.h"
+#include "Simd.h"
+#include "TagTable.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// counts hardware cache misses of this thread between start and stop
+class CacheMissCounter
+{
+private:
+    int file = -1;
+    int error = 0;
+
+public:
+    CacheMissCounter()
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        file = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (file < 0)
+            error = errno;
+#else
+        error = ENOSYS;
+#endif
+    }
+
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if (file >= 0)
+            close(file);
+#endif
+    }
+
+    bool available() const { return file >= 0; }
+
+    // why counting is unavailable, only permissions can be fixed by the user
+    const char* unavailableReason() const
+    {
+        if (error == EACCES || error == EPERM)
+            return "perf events are not permitted here, lower /proc/sys/kernel/perf_event_paranoid";
+
+        return "this machine has no hardware cache miss counter, common in virtual machines";
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        if (file >= 0)
+        {
+            ioctl(file, PERF_EVENT_IOC_RESET, 0);
+            ioctl(file, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop()
+    {
+        long long count = 0;
+#ifdef __linux__
+        if (file >= 0)
+        {
+            ioctl(file, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(file, &count, sizeof(count)) != sizeof(count))
+                count = 0;
+        }
+#endif
+        return count;
+    }
+};
+
+// tag IDs of a parent block with wavy layers and some noise, like a geological model
+static vector<uchar> makeSyntheticGrid(vec3<ushort> size, uint seed)
+{
+    mt19937 rng(seed);
+    vector<uchar> ids(size.volume());
+
+    const uint numLayers = 5;
+    const double phase = rng() % 100 / 10.0;
+
+    size_t i = 0;
+    for (ushort z = 0; z < size.z; z++)
+        for (ushort y = 0; y < size.y; y++)
+            for (ushort x = 0; x < size.x; x++)
+            {
+                double height = z + 2.0 * sin((x + phase) * 0.3) + 1.5 * cos((y + phase) * 0.2);
+                uchar layer = (uchar)min<double>(numLayers - 1, max(0.0, height * numLayers / size.z));
+
+                // occasional voxels of ore inside the layers
+                ids[i++] = rng() % 50 == 0 ? (uchar)numLayers : layer;
+            }
+
+    return ids;
+}
+
+// check every run finder splits each row of the grids exactly like the scalar version
+static bool runFindersMatch(const vector<vector<uchar>>& grids, uint rowLength)
+{
+    const RunFinder::RunFunction variants[] = { RunFinder::findRunsSSE2, RunFinder::findRunsAVX2 };
+    const bool supported[] = { cpuHasSSE2(), cpuHasAVX2() };
+
+    vector<ushort> expected(rowLength);
+    vector<ushort> actual(rowLength);
+    for (int v = 0; v < 2; v++)
+    {
+        if (!supported[v])
+            continue;
+
+        for (const vector<uchar>& grid : grids)
+        {
+            for (size_t row = 0; row < grid.size(); row += rowLength)
+            {
+                uint numRuns = RunFinder::findRunsScalar(grid.data() + row, rowLength, expected.data());
+                if (variants[v](grid.data() + row, rowLength, actual.data()) != numRuns
+                    || !equal(expected.begin(), expected.begin() + numRuns, actual.begin()))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+struct Measurement
+{
+    double nsPerVoxel;
+    double missesPerVoxel;          // negative when perf events are unavailable
+    double blockBytesPerVoxel;      // block list storage of the lines before merging, the most a pass walks
+    size_t outputBytes;
+};
+
+// one block in every BlockList array and its valid bit
+static const double BLOCK_BYTES = sizeof(SubVolume) + sizeof(uchar) + sizeof(uint) + 1.0 / 8;
+
+// compress every grid several times and keep the fastest run
+static Measurement measure(vec3<ushort> pBlockDim, const vector<vector<uchar>>& grids, TagTable& tagTable, bool specialise)
+{
+    ParentBlock::setup(pBlockDim, &tagTable, OutputFormat::text, specialise);
+
+    ParentBlock parentBlock({ 0, 0, 0 });
+    CacheMissCounter counter;
+
+    double bestSeconds = 1e30;
+    long long bestMisses = 0;
+    size_t outputBytes = 0;
+    size_t numLines = 0;
+    for (int run = 0; run < 5; run++)
+    {
+        outputBytes = 0;
+        numLines = 0;
+
+        counter.start();
+        auto start = chrono::steady_clock::now();
+
+        for (const vector<uchar>& grid : grids)
+        {
+            parentBlock.storeVoxels(grid.data(), pBlockDim.x, (size_t)pBlockDim.x * pBlockDim.y);
+            numLines += parentBlock.getBlocks().size();
+            parentBlock.compressPrint();
+            outputBytes += parentBlock.getOutput().size();
+            parentBlock.reset(0);
+        }
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        long long misses = counter.stop();
+
+        if (elapsed.count() < bestSeconds)
+        {
+            bestSeconds = elapsed.count();
+            bestMisses = misses;
+        }
+    }
+
+    const double numVoxels = (double)pBlockDim.volume() * grids.size();
+    return { bestSeconds * 1e9 / numVoxels, counter.available() ? bestMisses / numVoxels : -1.0, numLines * BLOCK_BYTES / numVoxels, outputBytes };
+}
+
+static void printMeasurement(const char* kernel, const Measurement& measurement)
+{
+    cout << "  " << kernel << ": " << measurement.nsPerVoxel << " ns/voxel";
+
+    if (measurement.missesPerVoxel >= 0)
+        cout << ", " << measurement.missesPerVoxel << " cache misses/voxel";
+
+    cout << ", " << measurement.blockBytesPerVoxel << " block list bytes/voxel\n";
+}
+
+int main(int argc, char* argv[])
+{
+    vector<ushort> sizes = { 8, 16, 32, 64 };
+    if (argc > 1)
+        sizes = { (ushort)stoi(argv[1]) };
+
+    // about the same number of voxels for every shape
+    const unsigned long long voxelsPerShape = argc > 2 ? stoull(argv[2]) : 4194304;
+
+    TagTable tagTable;
+    for (const char* name : { "air", "soil", "clay", "sandstone", "granite", "ore" })
+        tagTable.getID(name);
+
+    CacheMissCounter counter;
+    if (!counter.available())
+        cout << "cache misses: unavailable, " << counter.unavailableReason() << "\n";
+
+    for (ushort size : sizes)
+    {
+        vec3<ushort> pBlockDim = { size, size, size };
+        const uint numGrids = (uint)max(1ull, voxelsPerShape / pBlockDim.volume());
+
+        vector<vector<uchar>> grids;
+        for (uint i = 0; i < numGrids; i++)
+            grids.push_back(makeSyntheticGrid(pBlockDim, i));
+
+        if (!runFindersMatch(grids, size))
+        {
+            cout << size << "^3: MISMATCH between vector and scalar run finders\n";
+            return 1;
+        }
+
+        Measurement runtime = measure(pBlockDim, grids, tagTable, false);
+        const char* runtimeName = ParentBlock::getKernelName();
+        Measurement specialised = measure(pBlockDim, grids, tagTable, true);
+        const char* specialisedName = ParentBlock::getKernelName();
+
+        if (runtime.outputBytes != specialised.outputBytes)
+        {
+            cout << size << "^3: MISMATCH between runtime and specialised kernels\n";
+            return 1;
+        }
+
+        cout << size << "^3, " << numGrids << " parent blocks\n";
+        printMeasurement(runtimeName, runtime);
+        printMeasurement(specialisedName, specialised);
+        if (strcmp(runtimeName, specialisedName) == 0)
+            cout << "  no specialised kernels for this shape\n";
+        else
+            cout << "  speedup: " << runtime.nsPerVoxel / specialised.nsPerVoxel << "x\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+// Benchmark of the parse, compress and emit stages on a suite of synthetic models
+// every model is generated in memory as text input, so no datasets or disk reads are needed
+// each stage is timed on its own over the whole volume and the best of several runs is kept
+// results are written as CSV, one row per model, so runs can be compared to find regressions
+// models are run with 8 bit tag IDs and again with the 16 bit IDs used for more than 256 tags, as separate rows
+//
+// usage: PipelineBenchmark [--runs N] [--output results.csv] [--quick]
+// without --output the CSV goes to stdout, a readable summary always goes to stderr
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ParentBlock.h"
+#include "TagReader.h"
+#include "TagTable.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+enum class ModelKind { uniform, strata, noise, sphere, manyTags };
+
+struct Model
+{
+    ModelKind kind;
+    const char* name;
+    vec3<ushort> volumeDim;
+    vec3<ushort> pBlockDim;
+    bool wideIDs;
+};
+
+// best time of each stage and what it produced
+struct Result
+{
+    double parseSeconds = 1e30;
+    double compressSeconds = 1e30;
+    double emitSeconds = 1e30;
+    size_t inputBytes = 0;
+    size_t outputBytes = 0;
+    unsigned long long numBlocks = 0;
+};
+
+static const char* TAGS[] = { "air", "soil", "clay", "sandstone", "granite", "ore_high_grade", "water", "basalt" };
+static const uint NUM_TAGS = sizeof(TAGS) / sizeof(TAGS[0]);
+
+// number of tags in the many tags model, too many for 8 bit IDs
+#define MANY_TAGS 1000
+
+// names repeat with a suffix past the list so any number of tags can be named
+static string tagName(uint tag)
+{
+    string name = TAGS[tag % NUM_TAGS];
+    if (tag >= NUM_TAGS)
+    {
+        name += '_';
+        name += to_string(tag / NUM_TAGS);
+    }
+
+    return name;
+}
+
+// tag of one voxel of a model, deterministic in position apart from the noise
+static uint tagAt(const Model& model, uint x, uint y, uint z, mt19937& rng)
+{
+    const vec3<ushort>& size = model.volumeDim;
+
+    switch (model.kind)
+    {
+    case ModelKind::uniform:
+        return 1;
+
+    case ModelKind::strata:
+    {
+        // gently folded layers a few voxels thick
+        double height = z + 3.0 * sin(x * 0.05) + 2.0 * cos(y * 0.07);
+        return (uint)max(0.0, height / 6) % 5;
+    }
+
+    case ModelKind::noise:
+        return rng() % 10 < 3 ? rng() % 8 : (z / 4) % 3;
+
+    case ModelKind::sphere:
+    {
+        // a body with a core and a shell, like a scanned object in air
+        double dx = x - size.x / 2.0, dy = (y - size.y / 2.0) * 1.3, dz = z - size.z / 2.0;
+        double distance = sqrt(dx * dx + dy * dy + dz * dz);
+        double radius = min({ size.x, size.y, size.z }) / 2.5;
+        return distance < radius * 0.5 ? 3 : distance < radius ? 4 : 0;
+    }
+
+    case ModelKind::manyTags:
+    {
+        // thin folded layers each with their own tag, plus noise from the layers just above
+        // keeps well under 256 tags in any parent block while the model has MANY_TAGS
+        double height = z + 3.0 * sin(x * 0.05) + 2.0 * cos(y * 0.07);
+        uint layer = (uint)max(0.0, height / 2) + (rng() % 10 < 3 ? rng() % 8 : 0);
+        return layer % MANY_TAGS;
+    }
+    }
+
+    return 0;
+}
+
+// the model in the text input format
+static string makeInput(const Model& model)
+{
+    mt19937 rng(42);
+    const vec3<ushort>& size = model.volumeDim;
+
+    string input = to_string(size.x) + "," + to_string(size.y) + "," + to_string(size.z) + ","
+        + to_string(model.pBlockDim.x) + "," + to_string(model.pBlockDim.y) + "," + to_string(model.pBlockDim.z) + "\n";
+    input.reserve((size_t)size.x * size.y * size.z * 24);
+
+    for (uint z = 0; z < size.z; z++)
+        for (uint y = 0; y < size.y; y++)
+            for (uint x = 0; x < size.x; x++)
+                input += to_string(x) + "," + to_string(y) + "," + to_string(z) + ",1,1,1,'" + tagName(tagAt(model, x, y, z, rng)) + "'\n";
+
+    return input;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// parse, compress and emit the whole model once, keeping each stage's time if it is the best so far
+template <typename ID>
+static void runOnce(const Model& model, const string& input, Result& result)
+{
+    vec3<uint> volumeDim = model.volumeDim.cast<uint>();
+    vec3<ushort> pBlockDim = model.pBlockDim;
+    const vec3<uint> numPBlocks = volumeDim / pBlockDim.cast<uint>();
+    const size_t slabSize = (size_t)volumeDim.x * volumeDim.y * pBlockDim.z;
+
+    BasicTagTable<ID> tagTable;
+    vector<ID> ids((size_t)volumeDim.x * volumeDim.y * volumeDim.z);
+
+    // parse every plane of parent blocks into one grid of IDs
+    auto start = chrono::steady_clock::now();
+    TagReader::setup(input.data(), input.data() + input.size());
+    for (uint plane = 0; plane < numPBlocks.z; plane++)
+    {
+        ID* slab = ids.data() + plane * slabSize;
+        const ID* read = TagReader::readTagIDs(slab, slabSize, volumeDim, tagTable);
+        if (read != slab)
+            memcpy(slab, read, slabSize * sizeof(ID));
+    }
+    result.parseSeconds = min(result.parseSeconds, secondsSince(start));
+
+    ParentBlock::setup(pBlockDim, &tagTable, OutputFormat::text);
+
+    vector<ParentBlock> parentBlocks;
+    for (uint y = 0; y < numPBlocks.y; y++)
+        for (uint x = 0; x < numPBlocks.x; x++)
+            parentBlocks.emplace_back(vec3<uint>{ x * pBlockDim.x, y * pBlockDim.y, 0 });
+
+    // compress and emit a plane at a time like the pipeline, timing the two separately
+    double compressSeconds = 0;
+    double emitSeconds = 0;
+    size_t outputBytes = 0;
+    unsigned long long numBlocks = 0;
+    ThreadPool& pool = ThreadPool::shared();
+
+    for (uint plane = 0; plane < numPBlocks.z; plane++)
+    {
+        const ID* slab = ids.data() + plane * slabSize;
+
+        start = chrono::steady_clock::now();
+        pool.parallelFor(parentBlocks.size(), [&](size_t i)
+        {
+            const ID* origin = slab + (i % numPBlocks.x) * pBlockDim.x + (i / numPBlocks.x) * pBlockDim.y * volumeDim.x;
+            parentBlocks[i].storeVoxels(origin, volumeDim.x, (size_t)volumeDim.x * volumeDim.y);
+            parentBlocks[i].compressBlocks();
+        });
+        compressSeconds += secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        pool.parallelFor(parentBlocks.size(), [&](size_t i)
+        {
+            parentBlocks[i].printCompressed();
+        });
+        emitSeconds += secondsSince(start);
+
+        for (ParentBlock& parentBlock : parentBlocks)
+        {
+            outputBytes += parentBlock.getOutput().size();
+            numBlocks += parentBlock.getNumBlocks();
+            parentBlock.reset(1);
+        }
+    }
+
+    result.compressSeconds = min(result.compressSeconds, compressSeconds);
+    result.emitSeconds = min(result.emitSeconds, emitSeconds);
+    result.inputBytes = input.size();
+    result.outputBytes = outputBytes;
+    result.numBlocks = numBlocks;
+}
+
+static vector<Model> makeSuite(bool quick)
+{
+    const pair<ModelKind, const char*> kinds[] = {
+        { ModelKind::uniform, "uniform" }, { ModelKind::strata, "strata" },
+        { ModelKind::noise, "noise" }, { ModelKind::sphere, "sphere" },
+        { ModelKind::manyTags, "many_tags" } };
+
+    vector<vec3<ushort>> volumes = { { 64, 64, 64 } };
+    if (!quick)
+        volumes.push_back({ 256, 256, 64 });
+
+    // the same models with 16 bit IDs come after the 8 bit ones, the many tags model only has 16 bit IDs
+    vector<Model> suite;
+    for (bool wideIDs : { false, true })
+        for (const auto& [kind, name] : kinds)
+            if (wideIDs || kind != ModelKind::manyTags)
+                for (const vec3<ushort>& volume : volumes)
+                    for (ushort size : { 8, 16, 32 })
+                        suite.push_back({ kind, name, volume, { size, size, size }, wideIDs });
+
+    return suite;
+}
+
+int main(int argc, char* argv[])
+{
+    uint numRuns = 3;
+    bool quick = false;
+    string outputPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            numRuns = max(1, atoi(argv[++i]));
+        else if (arg == "--output" && i + 1 < argc)
+            outputPath = argv[++i];
+        else if (arg == "--quick")
+            quick = true;
+        else
+        {
+            cerr << "usage: PipelineBenchmark [--runs N] [--output results.csv] [--quick]\n";
+            return 1;
+        }
+    }
+
+    ofstream file;
+    if (!outputPath.empty())
+    {
+        file.open(outputPath);
+        if (!file)
+        {
+            cerr << "cannot write " << outputPath << "\n";
+            return 2;
+        }
+    }
+    ostream& csv = outputPath.empty() ? cout : file;
+
+    cerr << ThreadPool::shared().getNumThreads() << " threads, best of " << numRuns << " runs\n";
+    csv << "model,id_bits,volume_x,volume_y,volume_z,parent_x,parent_y,parent_z,voxels,threads,input_bytes,output_bytes,blocks,"
+        "parse_s,compress_s,emit_s,parse_mb_per_s,compress_mvoxels_per_s,emit_mb_per_s\n";
+
+    for (const Model& model : makeSuite(quick))
+    {
+        vec3<ushort> volumeDim = model.volumeDim;
+        const string input = makeInput(model);
+
+        Result result;
+        for (uint run = 0; run < numRuns; run++)
+        {
+            if (model.wideIDs)
+                runOnce<ushort>(model, input, result);
+            else
+                runOnce<uchar>(model, input, result);
+        }
+
+        const double voxels = (double)volumeDim.volume();
+        const double parseRate = result.inputBytes / result.parseSeconds / 1e6;
+        const double compressRate = voxels / result.compressSeconds / 1e6;
+        const double emitRate = result.outputBytes / result.emitSeconds / 1e6;
+
+        const int idBits = model.wideIDs ? 16 : 8;
+
+        csv << model.name << "," << idBits << "," << model.volumeDim.x << "," << model.volumeDim.y << "," << model.volumeDim.z << ","
+            << model.pBlockDim.x << "," << model.pBlockDim.y << "," << model.pBlockDim.z << ","
+            << volumeDim.volume() << "," << ThreadPool::shared().getNumThreads() << ","
+            << result.inputBytes << "," << result.outputBytes << "," << result.numBlocks << ","
+            << result.parseSeconds << "," << result.compressSeconds << "," << result.emitSeconds << ","
+            << parseRate << "," << compressRate << "," << emitRate << "\n";
+
+        cerr << model.name << " " << model.volumeDim.x << "x" << model.volumeDim.y << "x" << model.volumeDim.z
+            << " / " << model.pBlockDim.x << "^3, " << idBits << " bit IDs: parse " << parseRate << " MB/s, compress " << compressRate
+            << " Mvoxels/s, emit " << emitRate << " MB/s, " << result.numBlocks << " blocks\n";
+    }
+
+    return 0;
+}
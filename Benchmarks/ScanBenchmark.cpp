@@ -0,0 +1,165 @@
+// Microbenchmark for TagScanner
+// checks every scan function finds exactly the same tags as the scalar version, then reports throughput
+//
+// usage: ScanBenchmark [dataset.csv]
+// without a dataset a synthetic volume is generated in memory
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "TagScanner.h"
+#include "Simd.h"
+
+using namespace std;
+
+struct ScanVariant
+{
+    const char* name;
+    TagScanner::ScanFunction scan;
+    bool supported;
+};
+
+// voxel descriptions of a volume with a handful of tags of varying length
+static string makeSyntheticInput(uint sizeX, uint sizeY, uint sizeZ)
+{
+    const string tags[] = { "air", "rock", "sandstone_layer_2", "ore", "w", "clay_with_a_much_longer_name" };
+    mt19937 rng(42);
+
+    string input = to_string(sizeX) + "," + to_string(sizeY) + "," + to_string(sizeZ) + ",8,8,8\n";
+    input.reserve((size_t)sizeX * sizeY * sizeZ * 24);
+
+    uint tag = 0;
+    for (uint z = 0; z < sizeZ; z++)
+        for (uint y = 0; y < sizeY; y++)
+            for (uint x = 0; x < sizeX; x++)
+            {
+                // runs of the same tag like real models
+                if (rng() % 8 == 0)
+                    tag = rng() % 6;
+
+                input += to_string(x) + "," + to_string(y) + "," + to_string(z) + ",1,1,1,'" + tags[tag] + "'\n";
+            }
+
+    return input;
+}
+
+// scan every row of the input, returns total tags found
+static size_t scanAll(TagScanner::ScanFunction scan, const char* begin, const char* end, vector<string_view>& row)
+{
+    size_t total = 0;
+    while (begin < end)
+    {
+        uint found = scan(begin, end, row.data(), (uint)row.size());
+        total += found;
+
+        if (found < row.size())
+            break;
+    }
+
+    return total;
+}
+
+// compare a scan function against the scalar version row by row
+static bool matchesScalar(TagScanner::ScanFunction scan, const char* begin, const char* end, uint rowLength)
+{
+    vector<string_view> expected(rowLength);
+    vector<string_view> actual(rowLength);
+    const char* expectedIter = begin;
+    const char* actualIter = begin;
+
+    while (expectedIter < end)
+    {
+        uint expectedFound = TagScanner::scanScalar(expectedIter, end, expected.data(), rowLength);
+        uint actualFound = scan(actualIter, end, actual.data(), rowLength);
+
+        if (expectedFound != actualFound || expectedIter != actualIter)
+            return false;
+
+        for (uint i = 0; i < expectedFound; i++)
+        {
+            if (expected[i].data() != actual[i].data() || expected[i].size() != actual[i].size())
+                return false;
+        }
+
+        if (expectedFound < rowLength)
+            break;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    string input;
+    if (argc > 1)
+    {
+        ifstream file(argv[1], ios::binary);
+        if (!file)
+        {
+            cerr << "Could not open " << argv[1] << "\n";
+            return 1;
+        }
+
+        stringstream contents;
+        contents << file.rdbuf();
+        input = contents.str();
+    }
+    else
+    {
+        input = makeSyntheticInput(512, 512, 48);
+    }
+
+    // rows are as long as the volume's x dimension
+    size_t firstLineEnd = input.find('\n');
+    size_t firstDigit = input.find_first_of("0123456789");
+    uint rowLength = (uint)stoul(input.substr(firstDigit, firstLineEnd - firstDigit));
+
+    const char* begin = input.data() + firstLineEnd + 1;
+    const char* end = input.data() + input.size();
+    const double gigabytes = (end - begin) / 1e9;
+
+    ScanVariant variants[] =
+    {
+        { "scalar", TagScanner::scanScalar, true },
+        { "sse2", TagScanner::scanSSE2, cpuHasSSE2() },
+        { "avx2", TagScanner::scanAVX2, cpuHasAVX2() },
+    };
+
+    cout << "input: " << gigabytes << " GB, row length " << rowLength << "\n";
+
+    vector<string_view> row(rowLength);
+    for (const ScanVariant& variant : variants)
+    {
+        if (!variant.supported)
+        {
+            cout << variant.name << ": not supported by this CPU\n";
+            continue;
+        }
+
+        if (!matchesScalar(variant.scan, begin, end, rowLength))
+        {
+            cout << variant.name << ": MISMATCH against scalar scan\n";
+            return 1;
+        }
+
+        // best of several runs
+        double bestSeconds = 1e30;
+        size_t numTags = 0;
+        for (int run = 0; run < 5; run++)
+        {
+            auto start = chrono::steady_clock::now();
+            numTags = scanAll(variant.scan, begin, end, row);
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            bestSeconds = min(bestSeconds, elapsed.count());
+        }
+
+        cout << variant.name << ": " << gigabytes / bestSeconds << " GB/s (" << numTags << " tags)\n";
+    }
+
+    return 0;
+}
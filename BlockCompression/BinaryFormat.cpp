@@ -0,0 +1,210 @@
+#include "BinaryFormat.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "OutputStream.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+void BinaryFormat::writeHeader(BlockWriter& writer, vec3<ushort> volumeDim, vec3<ushort> pBlockDim)
+{
+    writer.writeChars(BINARY_MAGIC, 4);
+    writer.writeUShort(BINARY_VERSION);
+
+    writer.writeUShort(volumeDim.x);
+    writer.writeUShort(volumeDim.y);
+    writer.writeUShort(volumeDim.z);
+    writer.writeUShort(pBlockDim.x);
+    writer.writeUShort(pBlockDim.y);
+    writer.writeUShort(pBlockDim.z);
+}
+
+// write names of the tags with IDs [firstID, firstID + count)
+void BinaryFormat::writeTags(BlockWriter& writer, const TagNames& tagNames, int firstID, int count)
+{
+    writer.writeByte(RECORD_TAGS);
+    writer.writeUShort((ushort)firstID);
+    writer.writeUShort((ushort)count);
+
+    for (int id = firstID; id < firstID + count; id++)
+    {
+        const string* name = tagNames.getTagPointer(id);
+        writer.writeUShort((ushort)name->size());
+        writer.writeChars(name->data(), name->size());
+    }
+}
+
+// start a parent block's record, followed by 'numBlocks' calls to writeBinaryBlock
+void BinaryFormat::writeParentBlockStart(BlockWriter& writer, vec3<ushort> pBlockPosition, uint numBlocks)
+{
+    writer.writeByte(RECORD_PARENT_BLOCK);
+    writer.writeUShort(pBlockPosition.x);
+    writer.writeUShort(pBlockPosition.y);
+    writer.writeUShort(pBlockPosition.z);
+    writer.writeUInt(numBlocks);
+}
+
+void BinaryFormat::writeEnd(BlockWriter& writer)
+{
+    writer.writeByte(RECORD_END);
+}
+
+// streams binary input through a fixed buffer
+class BinaryReader
+{
+private:
+    FILE* in;
+    vector<uchar> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+
+    // make sure 'length' bytes are buffered
+    void need(size_t length)
+    {
+        if (end - begin >= length)
+            return;
+
+        // move what is left to the front and read more after it
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+
+        if (buffer.size() < length)
+            buffer.resize(length);
+
+        end += fread(buffer.data() + end, 1, buffer.size() - end, in);
+        if (end < length)
+        {
+            cerr << "Binary input ended unexpectedly\n";
+            exit(2);
+        }
+    }
+
+public:
+    BinaryReader(FILE* _in) : in(_in), buffer(1048576)
+    {
+    }
+
+    uchar readByte()
+    {
+        need(1);
+        return buffer[begin++];
+    }
+
+    ushort readUShort()
+    {
+        need(2);
+        ushort value = (ushort)(buffer[begin] | buffer[begin + 1] << 8);
+        begin += 2;
+        return value;
+    }
+
+    uint readUInt()
+    {
+        uint low = readUShort();
+        return low | (uint)readUShort() << 16;
+    }
+
+    string readChars(size_t length)
+    {
+        need(length);
+        string chars((const char*)buffer.data() + begin, length);
+        begin += length;
+        return chars;
+    }
+};
+
+void BinaryFormat::decode(FILE* in)
+{
+#ifdef _WIN32
+    _setmode(_fileno(in), _O_BINARY);
+#endif
+
+    BinaryReader reader(in);
+
+    if (reader.readChars(4) != BINARY_MAGIC || reader.readUShort() != BINARY_VERSION)
+    {
+        cerr << "Input is not binary block output\n";
+        exit(2);
+    }
+
+    // volume size is not needed to rebuild the text
+    for (int i = 0; i < 3; i++)
+        reader.readUShort();
+
+    vec3<ushort> pBlockDim;
+    pBlockDim.x = reader.readUShort();
+    pBlockDim.y = reader.readUShort();
+    pBlockDim.z = reader.readUShort();
+
+    vector<string> quotedTags;
+    BlockWriter writer;
+
+    while (true)
+    {
+        const uchar type = reader.readByte();
+
+        if (type == RECORD_TAGS)
+        {
+            const ushort firstID = reader.readUShort();
+            const ushort count = reader.readUShort();
+
+            quotedTags.resize(max((size_t)(firstID + count), quotedTags.size()));
+            for (ushort id = firstID; id < firstID + count; id++)
+            {
+                string& quoted = quotedTags[id];
+                quoted.assign(1, '\'');
+                quoted += reader.readChars(reader.readUShort());
+                quoted += '\'';
+            }
+        }
+        else if (type == RECORD_PARENT_BLOCK)
+        {
+            vec3<ushort> pBlockPosition;
+            pBlockPosition.x = reader.readUShort();
+            pBlockPosition.y = reader.readUShort();
+            pBlockPosition.z = reader.readUShort();
+            const vec3<ushort> originWS = pBlockPosition * pBlockDim;
+
+            const uint numBlocks = reader.readUInt();
+            for (uint i = 0; i < numBlocks; i++)
+            {
+                vec3<ushort> origin, size;
+                origin.x = reader.readUShort();
+                origin.y = reader.readUShort();
+                origin.z = reader.readUShort();
+                size.x = reader.readUShort();
+                size.y = reader.readUShort();
+                size.z = reader.readUShort();
+                const uchar ID = reader.readByte();
+
+                if (ID >= quotedTags.size())
+                {
+                    cerr << "Binary input uses a tag before naming it\n";
+                    exit(2);
+                }
+
+                writer.writeBlock((origin + originWS).cast<uint>(), size, quotedTags[ID]);
+            }
+
+            OutputStream::write(writer.data(), writer.size());
+            writer.clear();
+        }
+        else if (type == RECORD_END)
+        {
+            break;
+        }
+        else
+        {
+            cerr << "Unknown record in binary input\n";
+            exit(2);
+        }
+    }
+
+    OutputStream::flush();
+}
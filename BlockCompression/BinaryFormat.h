@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+#include "BlockWriter.h"
+#include "TagTable.h"
+#include "vec3.h"
+#include "uDataTypes.h"
+
+// Binary output format
+//
+// All integers are little-endian.
+// header: "BCMP", ushort version, ushort volume size x/y/z, ushort parent block size x/y/z
+// followed by records, each starting with a char giving its type
+//  'T' tags:          ushort first ID, ushort count, then count * (ushort length, chars of name)
+//  'P' parent block:  ushort position x/y/z in parent blocks, uint block count,
+//                     then count * (ushort origin x/y/z relative to the parent block, ushort size x/y/z, uchar tag ID)
+//  'E' end of output
+// the tags found in the first plane follow the header, tags found later get a record before the first parent block using them
+
+#define BINARY_MAGIC "BCMP"
+#define BINARY_VERSION 1
+
+#define RECORD_TAGS 'T'
+#define RECORD_PARENT_BLOCK 'P'
+#define RECORD_END 'E'
+
+class BinaryFormat
+{
+public:
+	static void writeHeader(BlockWriter& writer, vec3<ushort> volumeDim, vec3<ushort> pBlockDim);
+	static void writeTags(BlockWriter& writer, const TagNames& tagNames, int firstID, int count);
+	static void writeParentBlockStart(BlockWriter& writer, vec3<ushort> pBlockPosition, uint numBlocks);
+	static void writeEnd(BlockWriter& writer);
+
+	// convert binary output read from 'in' back to the text format on stdout
+	static void decode(FILE* in);
+};
@@ -0,0 +1,178 @@
+#include "BlockCache.h"
+
+#include <cstring>
+
+// lookups before the hit rate is trusted, and the hit rate under which lookups are sampled
+// the first planes are read before any is compressed and always miss, so the warm-up covers several planes of most models
+#define WARMUP_LOOKUPS 4096
+#define MIN_HIT_PERCENT 1
+
+// one column of parent blocks in this many is still looked up and cached once the hit rate is under MIN_HIT_PERCENT
+// the same columns are sampled in every plane, so the cache comes back if the model starts repeating
+#define SAMPLE_INTERVAL 16
+
+size_t BlockCache::Entry::getBytes() const
+{
+    return sizeof(Entry) + ids.size() + IDs.size() * (2 * sizeof(vec3<ushort>) + 1);
+}
+
+BlockCache::BlockCache(size_t budgetBytes) : budget(budgetBytes)
+{
+}
+
+BlockCache& BlockCache::shared()
+{
+    static BlockCache cache;
+    return cache;
+}
+
+void BlockCache::setup(size_t budgetBytes)
+{
+    budget = budgetBytes;
+}
+
+bool BlockCache::isEnabled() const
+{
+    return budget != 0;
+}
+
+// mix every 8 bytes of each row into the hash, the row length is the same for every row so needs no mixing
+uint64_t BlockCache::hashVoxels(const uchar* ids, vec3<ushort> size, size_t rowStride, size_t planeStride)
+{
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = 0;
+
+    for (ushort z = 0; z < size.z; z++)
+    {
+        for (ushort y = 0; y < size.y; y++)
+        {
+            const uchar* row = ids + z * planeStride + y * rowStride;
+
+            ushort x = 0;
+            for (; x + 8 <= size.x; x += 8)
+            {
+                uint64_t word;
+                memcpy(&word, row + x, 8);
+                hash = (hash ^ word) * multiplier;
+                hash ^= hash >> 32;
+            }
+
+            // pad the end of the row with zeros
+            if (x < size.x)
+            {
+                uint64_t word = 0;
+                memcpy(&word, row + x, size.x - x);
+                hash = (hash ^ word) * multiplier;
+                hash ^= hash >> 32;
+            }
+        }
+    }
+
+    return hash;
+}
+
+inline bool BlockCache::matches(const Entry& entry, const uchar* ids, vec3<ushort> size, size_t rowStride, size_t planeStride)
+{
+    const uchar* cached = entry.ids.data();
+
+    for (ushort z = 0; z < size.z; z++)
+    {
+        for (ushort y = 0; y < size.y; y++, cached += size.x)
+        {
+            if (memcmp(cached, ids + z * planeStride + y * rowStride, size.x) != 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool BlockCache::shouldLookUp(uint columnX, uint columnY)
+{
+    const unsigned long long lookups = numLookups.load(memory_order_relaxed);
+    if (lookups < WARMUP_LOOKUPS || numHits.load(memory_order_relaxed) * 100 >= lookups * MIN_HIT_PERCENT)
+        return true;
+
+    // scatter the sampled columns so they do not line up with a pattern's period
+    const uint64_t column = (((uint64_t)columnX << 32) | columnY) * 0x9E3779B97F4A7C15ull;
+    if (column >> 32 < 0x100000000ull / SAMPLE_INTERVAL)
+        return true;
+
+    numSkipped.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+shared_ptr<const BlockCache::Entry> BlockCache::find(uint64_t hash, const uchar* ids, vec3<ushort> size, size_t rowStride, size_t planeStride)
+{
+    numLookups.fetch_add(1, memory_order_relaxed);
+
+    // only the table lookup is locked, the entry is kept alive by its shared_ptr while its voxels are compared
+    shared_ptr<const Entry> entry;
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        auto found = lookupTable.find(hash);
+        if (found == lookupTable.end())
+            return nullptr;
+
+        entry = *found->second;
+    }
+
+    if (!matches(*entry, ids, size, rowStride, planeStride))
+        return nullptr;
+
+    numHits.fetch_add(1, memory_order_relaxed);
+
+    // move to the front so it is dropped last, unless it was replaced or dropped while being compared
+    lock_guard<mutex> lock(cacheMutex);
+    auto found = lookupTable.find(hash);
+    if (found != lookupTable.end() && *found->second == entry)
+        entries.splice(entries.begin(), entries, found->second);
+
+    return entry;
+}
+
+bool BlockCache::contains(uint64_t hash)
+{
+    lock_guard<mutex> lock(cacheMutex);
+    return lookupTable.count(hash) != 0;
+}
+
+void BlockCache::insert(shared_ptr<const Entry> entry)
+{
+    const size_t bytes = entry->getBytes();
+    if (bytes > budget)
+        return;
+
+    lock_guard<mutex> lock(cacheMutex);
+
+    // another parent block with the same hash may have been compressed at the same time, keep the newest
+    auto found = lookupTable.find(entry->hash);
+    if (found != lookupTable.end())
+    {
+        usedBytes -= (*found->second)->getBytes();
+        entries.erase(found->second);
+        lookupTable.erase(found);
+    }
+
+    entries.push_front(entry);
+    lookupTable[entry->hash] = entries.begin();
+    usedBytes += bytes;
+
+    while (usedBytes > budget)
+    {
+        usedBytes -= entries.back()->getBytes();
+        lookupTable.erase(entries.back()->hash);
+        entries.pop_back();
+    }
+}
+
+void BlockCache::printStats(ostream& out)
+{
+    if (!isEnabled())
+        return;
+
+    const unsigned long long lookups = numLookups;
+    const double hitRate = lookups == 0 ? 0 : 100.0 * numHits / lookups;
+    out << "  block cache: " << numHits << " hits in " << lookups << " lookups (" << hitRate << "%), "
+        << numSkipped << " not looked up, " << usedBytes / 1048576.0 << " of " << budget / 1048576.0 << " MiB used\n";
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vec3.h"
+#include "uDataTypes.h"
+
+using namespace std;
+
+// compressed blocks of recently seen parent block contents, so a repeated pattern is only compressed once
+// keyed by a hash of the parent block's tag IDs, the IDs are kept too so a hash collision is never a hit
+// least recently used contents are dropped to stay inside a memory budget, a budget of 0 turns the cache off
+// once almost every lookup has missed, only a sample of columns of parent blocks are looked up so models that do not repeat pay little
+// each model being compressed has its own cache, the command line program uses the shared one
+class BlockCache
+{
+public:
+	// one parent block's contents and the blocks it compressed to, positions are local to the parent block
+	struct Entry
+	{
+		uint64_t hash;
+		vector<uchar> ids;					// every voxel, row-major
+		vector<vec3<ushort>> origins;
+		vector<vec3<ushort>> sizes;
+		vector<uchar> IDs;
+
+		size_t getBytes() const;			// memory counted against the budget
+	};
+
+private:
+	using EntryList = list<shared_ptr<const Entry>>;
+
+	size_t budget = 0;								// most bytes entries may use
+	size_t usedBytes = 0;
+	EntryList entries;								// most recently used first
+	unordered_map<uint64_t, EntryList::iterator> lookupTable;
+	mutex cacheMutex;								// guards entries and lookupTable, parent blocks are stored and compressed in parallel
+	atomic<unsigned long long> numLookups{0};
+	atomic<unsigned long long> numHits{0};
+	atomic<unsigned long long> numSkipped{0};		// parent blocks not looked up because the hit rate was too low
+
+	static bool matches(const Entry& entry, const uchar* ids, vec3<ushort> size, size_t rowStride, size_t planeStride);
+
+public:
+	BlockCache(size_t budgetBytes = 0);
+	static BlockCache& shared();					// cache of the command line program
+
+	void setup(size_t budgetBytes);
+	bool isEnabled() const;
+
+	// hash of a grid of tag IDs, 'ids' is the first voxel and rows and XY planes are the given distances apart
+	static uint64_t hashVoxels(const uchar* ids, vec3<ushort> size, size_t rowStride, size_t planeStride);
+
+	// whether to look up the parent block at this position in its plane, false for most once the hit rate is near zero
+	// a parent block that is not looked up must not be inserted either
+	bool shouldLookUp(uint columnX, uint columnY);
+
+	// cached blocks for exactly these voxels, or null
+	shared_ptr<const Entry> find(uint64_t hash, const uchar* ids, vec3<ushort> size, size_t rowStride, size_t planeStride);
+	bool contains(uint64_t hash);					// whether inserting would replace an entry
+	void insert(shared_ptr<const Entry> entry);
+
+	void printStats(ostream& out);
+};
@@ -1,58 +1,96 @@
+#include <climits>
 #include <iostream>
 #include <string>
-#include <thread>
+#include "BinaryFormat.h"
 #include "BlockPlane.h"
-#include "Timer.h"
+#include "Metrics.h"
+#include "Options.h"
+#include "Pipeline.h"
+#include "StripProcessor.h"
 
-int main()
+// compress or convert the model with IDs wide enough for its tags
+template <typename ID>
+static void run(const Options& options, vec3<uint> volumeDim, vec3<ushort> pBlockDim)
 {
-    //Timer t("global", true);
+    if (options.toBinary)
+    {
+        BlockPlane<ID>::setup(OutputFormat::binary, volumeDim, pBlockDim);
+        BlockPlane<ID>::convertToBinary();
+        return;
+    }
 
-    BlockPlane::setup();
+    ParentBlock::setEngine(CompressionEngine::create(options.engine));
+    BlockCache::shared().setup((size_t)options.cacheMegabytes * 1048576);
 
-    // check if only 1 block plane is needed
-    // if so run program using only 1
-    if (BlockPlane::canUseOnePlane())
+    if (!options.updatePath.empty())
     {
-        BlockPlane blockPlane = BlockPlane();
-        blockPlane.readBlockPlane();
-        blockPlane.printBlockPlane();
+        BlockPlane<ID>::setup(OutputFormat::text, volumeDim, pBlockDim);
+        BlockPlane<ID>::updateOutput(options.updatePath);
+        return;
+    }
 
-        //t.print();
-        return 0;
+    BlockPlane<ID>::setup(options.outputFormat, volumeDim, pBlockDim);
+
+    if (!options.metricsPath.empty())
+        Metrics::setup(BlockPlane<ID>::getNumPlanes());
+
+    if (options.memoryBudgetMegabytes != 0)
+    {
+        // one strip of a plane in memory at a time
+        StripProcessor<ID> processor((size_t)options.memoryBudgetMegabytes * 1048576);
+        processor.run();
+
+        if (options.printStats)
+            processor.printStats(cerr);
+    }
+    else
+    {
+        // read, compress and write planes at the same time
+        Pipeline<ID> pipeline(options.numPlanes);
+        pipeline.run();
+
+        if (options.printStats)
+            pipeline.printStats(cerr);
     }
 
-    // must setup all BlockPlanes together before using any
-    BlockPlane blockPlane1 = BlockPlane();
-    BlockPlane blockPlane2 = BlockPlane();
+    if (!options.metricsPath.empty())
+        Metrics::writeJSON(options.metricsPath);
+}
 
-    // pointers used to switch which is number 1/2
-    BlockPlane* writingPlane = &blockPlane1;
-    BlockPlane* readingPlane = &blockPlane2;
+int main(int argc, char* argv[])
+{
+    Options options = Options::parse(argc, argv);
 
-    // start reading the first plane so it can write while another reads
-    writingPlane->readBlockPlane();
+    if (options.decode)
+    {
+        BinaryFormat::decode(stdin);
+        return 0;
+    }
 
-    // stop when all planes have been read
-    while (BlockPlane::canRead())
+    // the description comes first so the model can choose how wide its IDs are
+    vec3<uint> volumeDim;
+    vec3<ushort> pBlockDim;
+    if (!TagReader::parseDescription(TagReader::setup(), volumeDim, pBlockDim))
     {
-        // start reading a second plane on background thread
-        auto readingThread = thread(&BlockPlane::readBlockPlane, readingPlane);
-
-        // print on main thread the results from first plane
-        writingPlane->printBlockPlane();
-
-        // once all threads are done switch thread's task between reading and writing
-        readingThread.join();
-        BlockPlane* temp = writingPlane;
-        writingPlane = readingPlane;
-        readingPlane = temp;
-    } 
-
-    // print final plane
-    writingPlane->printBlockPlane();
-    
-    //t.print();
+        cerr << "Input does not start with a valid volume description\n";
+        exit(2);
+    }
+
+    // text input cannot say how many tags it has, binary input lists them all
+    const bool wideIDs = options.wideTags || VoxelFormat::needsWideIDs(TagReader::getNumHeaderTags());
+    const bool wideVolume = volumeDim.x > USHRT_MAX || volumeDim.y > USHRT_MAX || volumeDim.z > USHRT_MAX;
+
+    // binary output and old outputs only have room for ushort coordinates and uchar IDs
+    if ((wideIDs || wideVolume) && !options.toBinary && (options.outputFormat == OutputFormat::binary || !options.updatePath.empty()))
+    {
+        cerr << "--binary and --update only work with volumes up to " << USHRT_MAX << " voxels across and up to 256 tags\n";
+        exit(2);
+    }
+
+    if (wideIDs)
+        run<ushort>(options, volumeDim, pBlockDim);
+    else
+        run<uchar>(options, volumeDim, pBlockDim);
 
     return 0;
 }
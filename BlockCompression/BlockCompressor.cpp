@@ -0,0 +1,111 @@
+#include "BlockCompressor.h"
+
+BlockCompressor::BlockCompressor(vec3<ushort> _volumeDim, vec3<ushort> _pBlockDim, const CompressionEngine* engine, size_t cacheBytes, ThreadPool& _pool)
+    : volumeDim(_volumeDim), pBlockDim(_pBlockDim), settings(_pBlockDim, nullptr, OutputFormat::text), cache(cacheBytes), pool(_pool),
+    nextPlane(0), numBlocks(0)
+{
+    numPBlocks = volumeDim / pBlockDim;
+
+    // blocks are handed over as IDs so no tag table is needed
+    settings.engine = engine;
+    if (cache.isEnabled())
+        settings.cache = &cache;
+
+    parentBlocks.reserve((size_t)numPBlocks.x * numPBlocks.y);
+    for (ushort y = 0; y < numPBlocks.y; y++)
+    {
+        for (ushort x = 0; x < numPBlocks.x; x++)
+            parentBlocks.emplace_back((vec3<ushort>{ x, y, 0 } * pBlockDim).cast<uint>(), settings);
+    }
+
+    compressed.resize(parentBlocks.size());
+}
+
+unique_ptr<BlockCompressor> BlockCompressor::create(vec3<ushort> volumeDim, vec3<ushort> pBlockDim, const CompressionEngine* engine, size_t cacheBytes, ThreadPool& pool)
+{
+    if (engine == nullptr || pBlockDim.x == 0 || pBlockDim.y == 0 || pBlockDim.z == 0
+        || volumeDim.x % pBlockDim.x != 0 || volumeDim.y % pBlockDim.y != 0 || volumeDim.z % pBlockDim.z != 0)
+        return nullptr;
+
+    return unique_ptr<BlockCompressor>(new BlockCompressor(volumeDim, pBlockDim, engine, cacheBytes, pool));
+}
+
+CompressStatus BlockCompressor::compressPlane(const uchar* ids, const BlockSink& sink)
+{
+    if (isFinished())
+        return CompressStatus::finished;
+
+    const size_t rowStride = volumeDim.x;
+    const size_t planeStride = (size_t)volumeDim.x * volumeDim.y;
+
+    // parent blocks are independent so use every thread, keeping their blocks to hand over in order afterwards
+    pool.parallelFor(parentBlocks.size(), [&](size_t pBlockIndex)
+    {
+        ParentBlock& parentBlock = parentBlocks[pBlockIndex];
+        const uchar* origin = ids + (pBlockIndex % numPBlocks.x) * pBlockDim.x + (pBlockIndex / numPBlocks.x) * pBlockDim.y * rowStride;
+
+        parentBlock.storeVoxels(origin, rowStride, planeStride);
+        parentBlock.compressBlocks();
+
+        vector<CompressedBlock>& blocks = compressed[pBlockIndex];
+        blocks.clear();
+        parentBlock.forEachCompressed([&blocks](vec3<uint> blockOrigin, vec3<ushort> size, uchar ID)
+        {
+            blocks.push_back({ blockOrigin.cast<ushort>(), size, ID });
+        });
+    });
+
+    // the sink is only ever called from this thread
+    for (size_t pBlockIndex = 0; pBlockIndex < parentBlocks.size(); pBlockIndex++)
+    {
+        const vector<CompressedBlock>& blocks = compressed[pBlockIndex];
+        sink(blocks.data(), blocks.size());
+        numBlocks += blocks.size();
+
+        parentBlocks[pBlockIndex].reset(1);
+    }
+
+    nextPlane++;
+    return CompressStatus::ok;
+}
+
+CompressStatus BlockCompressor::compress(const VoxelSource& source, const BlockSink& sink)
+{
+    if (isFinished())
+        return CompressStatus::finished;
+
+    slab.resize(getPlaneVoxels());
+
+    while (!isFinished())
+    {
+        source(slab.data(), slab.size());
+        compressPlane(slab.data(), sink);
+    }
+
+    return CompressStatus::ok;
+}
+
+ushort BlockCompressor::getNumPlanes() const
+{
+    return numPBlocks.z;
+}
+
+size_t BlockCompressor::getPlaneVoxels() const
+{
+    return (size_t)volumeDim.x * volumeDim.y * pBlockDim.z;
+}
+
+bool BlockCompressor::isFinished() const
+{
+    return nextPlane == numPBlocks.z;
+}
+
+unsigned long long BlockCompressor::getNumBlocks() const
+{
+    return numBlocks;
+}
+
+const char* BlockCompressor::getKernelName() const
+{
+    return settings.kernelName;
+}
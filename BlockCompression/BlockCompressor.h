@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "BlockCache.h"
+#include "CompressionEngine.h"
+#include "ParentBlock.h"
+#include "ThreadPool.h"
+#include "vec3.h"
+#include "uDataTypes.h"
+
+using namespace std;
+
+// block of compressed output, with its origin in the volume
+struct CompressedBlock
+{
+	vec3<ushort> origin;
+	vec3<ushort> size;
+	uchar ID;
+};
+
+// fills 'ids' with the tag IDs of the next 'count' voxels in row-major order
+using VoxelSource = function<void(uchar* ids, size_t count)>;
+
+// given the blocks of each parent block in turn, in the order the command line program writes them
+// the blocks are only valid during the call
+using BlockSink = function<void(const CompressedBlock* blocks, size_t count)>;
+
+// what a BlockCompressor call did, errors leave the compressor as it was
+enum class CompressStatus
+{
+	ok,
+	finished,		// every plane had already been compressed, nothing was read or given to the sink
+};
+
+// compresses one model from tag IDs in memory, for embedding in other programs
+// all state belongs to the instance, so any number of models can be compressed at once from different threads
+// tag IDs are the caller's own, naming tags is left to the caller
+// errors are returned rather than printed, nothing here ends the program
+//
+//     unique_ptr<BlockCompressor> compressor = BlockCompressor::create({ 256, 256, 64 }, { 16, 16, 16 });
+//     for (ushort plane = 0; plane < compressor->getNumPlanes(); plane++)
+//         compressor->compressPlane(ids + plane * compressor->getPlaneVoxels(), sink);
+class BlockCompressor
+{
+private:
+	vec3<ushort> volumeDim;
+	vec3<ushort> pBlockDim;
+	vec3<ushort> numPBlocks;
+	ParentBlock::Settings settings;					// parent blocks point at these so the compressor cannot move
+	BlockCache cache;
+	ThreadPool& pool;
+	vector<ParentBlock> parentBlocks;
+	vector<vector<CompressedBlock>> compressed;		// blocks of each parent block of the plane being compressed
+	vector<uchar> slab;								// IDs read from a VoxelSource
+	ushort nextPlane;
+	unsigned long long numBlocks;
+
+	BlockCompressor(vec3<ushort> volumeDim, vec3<ushort> pBlockDim, const CompressionEngine* engine, size_t cacheBytes, ThreadPool& pool);
+
+public:
+	// 'cacheBytes' is the memory budget of the cache of repeated parent blocks, 0 to compress every parent block
+	// null when 'engine' is null, a parent block dimension is 0 or the volume is not a whole number of parent blocks on every axis
+	static unique_ptr<BlockCompressor> create(vec3<ushort> volumeDim, vec3<ushort> pBlockDim, const CompressionEngine* engine = CompressionEngine::getDefault(),
+		size_t cacheBytes = 0, ThreadPool& pool = ThreadPool::shared());
+	BlockCompressor(const BlockCompressor&) = delete;
+	BlockCompressor& operator=(const BlockCompressor&) = delete;
+
+	// compress the next plane of parent blocks, planes must be given in order up Z
+	// 'ids' is the tag ID of every voxel in the plane in row-major order, getPlaneVoxels() of them
+	// returns finished once every plane has been compressed
+	CompressStatus compressPlane(const uchar* ids, const BlockSink& sink);
+
+	// compress every plane not yet compressed, reading each from 'source' in turn
+	// returns finished if every plane had already been compressed
+	CompressStatus compress(const VoxelSource& source, const BlockSink& sink);
+
+	ushort getNumPlanes() const;
+	size_t getPlaneVoxels() const;
+	bool isFinished() const;						// every plane has been compressed
+	unsigned long long getNumBlocks() const;		// blocks given to sinks so far
+	const char* getKernelName() const;
+};
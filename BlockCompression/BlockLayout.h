@@ -0,0 +1,63 @@
+#pragma once
+
+#include <type_traits>
+#include "uDataTypes.h"
+
+using namespace std;
+
+// shape of a parent block as seen by the compression kernels
+// cube layouts make the dimensions and strides compile-time constants for the common sizes,
+// so index maths folds away and loops over whole rows can be unrolled
+// the runtime layout takes them from the volume description and works for any shape
+
+// 16 bit block indices whenever every index and the null index fit
+template <unsigned long long Volume>
+using IndexFor = conditional_t<(Volume < 0xFFFF), ushort, uint>;
+
+template <ushort Size>
+struct CubeLayout
+{
+	using Index = IndexFor<(unsigned long long)Size * Size * Size>;
+
+	static constexpr ushort sizeX = Size;
+	static constexpr ushort sizeY = Size;
+	static constexpr ushort sizeZ = Size;
+
+	// distance between neighbouring voxels along each axis
+	static constexpr ulong strideX = 1;
+	static constexpr ulong strideY = Size;
+	static constexpr ulong strideZ = (ulong)Size * Size;
+
+	static void bind(ushort, ushort, ushort)
+	{
+	}
+};
+
+// dimensions shared by every runtime layout
+// models of different shapes can be compressed at once, so each thread binds the shape of the parent block
+// it is about to work on when a kernel starts
+struct RuntimeShape
+{
+	static inline thread_local ushort sizeX = 1;
+	static inline thread_local ushort sizeY = 1;
+	static inline thread_local ushort sizeZ = 1;
+
+	static constexpr ulong strideX = 1;
+	static inline thread_local ulong strideY = 1;
+	static inline thread_local ulong strideZ = 1;
+
+	static void bind(ushort x, ushort y, ushort z)
+	{
+		sizeX = x;
+		sizeY = y;
+		sizeZ = z;
+		strideY = x;
+		strideZ = (ulong)x * y;
+	}
+};
+
+template <typename IndexType>
+struct RuntimeLayout : RuntimeShape
+{
+	using Index = IndexType;
+};
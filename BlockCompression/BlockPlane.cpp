@@ -2,161 +2,269 @@
 
 using namespace std;
 
-TagTable BlockPlane::tagTable = TagTable();                                 // table of tags and associated ID's that have been previously seen
-vec3<ushort> BlockPlane::volumeDim = { 1, 1, 1 };                   // how many voxels fit in volume per dimension
-vec3<ushort> BlockPlane::pBlockDim = { 1, 1, 1 };                   // how many voxels fit in a parent-block per dimension
-vec3<ushort> BlockPlane::numPBlocks = { 1, 1, 1 };                  // how many Parent-blocks fit in volume per dimension
-ushort BlockPlane::currentPlane = 0;                                        // which XY plane (of parent blocks) is next to read
-ushort BlockPlane::numInstances = 0;                                           // how many Block Planes are active, used for shifting BlockPlane's Z position
-
-void BlockPlane::setup()
+template <typename ID> BasicTagTable<ID> BlockPlane<ID>::tagTable;         // table of tags and associated ID's that have been previously seen
+template <typename ID> vec3<uint> BlockPlane<ID>::volumeDim = { 1, 1, 1 };  // how many voxels fit in volume per dimension
+template <typename ID> vec3<ushort> BlockPlane<ID>::pBlockDim = { 1, 1, 1 }; // how many voxels fit in a parent-block per dimension
+template <typename ID> vec3<uint> BlockPlane<ID>::numPBlocks = { 1, 1, 1 }; // how many Parent-blocks fit in volume per dimension
+template <typename ID> uint BlockPlane<ID>::currentPlane = 0;               // which XY plane (of parent blocks) is next to read
+template <typename ID> uint BlockPlane<ID>::numInstances = 0;               // how many Block Planes are active, used for shifting BlockPlane's Z position
+template <typename ID> OutputFormat BlockPlane<ID>::outputFormat = OutputFormat::text;  // whether blocks are written as text or binary
+template <typename ID> int BlockPlane<ID>::numTagsWritten = -1;             // tags named in binary output so far, -1 before the header
+template <typename ID> unsigned long long BlockPlane<ID>::numBlocksWritten = 0;  // blocks written by every plane so far
+
+template <typename ID>
+void BlockPlane<ID>::setup(OutputFormat format, vec3<uint> volumeSize, vec3<ushort> pBlockSize)
 {
     // Set the dimensions
-    readDimensions();
+    volumeDim = volumeSize;
+    pBlockDim = pBlockSize;
+
+    // how many Parent-blocks fit in x and y and z dimensions
+    numPBlocks = volumeDim / pBlockDim.cast<uint>();
+    currentPlane = 0;
+
+    outputFormat = format;
+    if (outputFormat == OutputFormat::binary)
+        OutputStream::setBinaryMode();
+}
+
+// rough bytes per voxel of a strip for its lines, blocks and printed output, on top of its IDs and block indices
+#define STRIP_BLOCK_BYTES_PER_VOXEL 24
+
+template <typename ID>
+BlockPlane<ID>::BlockPlane() : BlockPlane(numPBlocks.y)
+{
 }
 
-BlockPlane::BlockPlane()
+template <typename ID>
+BlockPlane<ID>::BlockPlane(uint stripRows)
 {
     // track how many BlockPlanes exist and give each an ID
     planeID = numInstances;
     numInstances++;
 
+    numTagsRead = 0;
+    numStripRows = stripRows;
+    numRowsLoaded = stripRows;
+    stripPlane = 0;
+
     // create blocks for input to be stored in
     createParentBlocks();
-}
-
-// Get the first input line and set all dimension members
-inline void BlockPlane::readDimensions()
-{
-    // Get the dimension description
-    // always contained in first line
-    
-
-    string description = TagReader::setup();
-
-    // Replace comma characters with whitespace
-    for (auto& c : description) 
-        if (c == ',') c = ' ';
-
-    // Parse volume description
-    stringstream ss(description);
-    char ignore;
-    ss >> ignore
-        >> volumeDim.x
-        >> volumeDim.y
-        >> volumeDim.z
-        >> pBlockDim.x
-        >> pBlockDim.y
-        >> pBlockDim.z;
 
-    //pBlockDim.x = 2064;
-    //pBlockDim.y = 1840;
-    //pBlockDim.z = 260;
-
-    // how many Parent-blocks fit in x and y and z dimensions
-    numPBlocks =
-    {
-        (ushort)(volumeDim.x / pBlockDim.x),
-        (ushort)(volumeDim.y / pBlockDim.y),
-        (ushort)(volumeDim.z / pBlockDim.z)
-    };
-
-    currentPlane = 0;
+    // space for the tag ID of every voxel in the plane
+    slab.resize((size_t)volumeDim.x * numStripRows * pBlockDim.y * pBlockDim.z);
+    slabIDs = slab.data();
 }
 
 // Using the dimension information, allocate memory required to store a parent-block-plane's voxels and origin coordinates
-inline void BlockPlane::createParentBlocks()
+template <typename ID>
+inline void BlockPlane<ID>::createParentBlocks()
 {
     // set important static variables in ParentBlock
-    ParentBlock::setup(pBlockDim, &tagTable);
+    ParentBlock::setup(pBlockDim, &tagTable, outputFormat);
 
     // create 2D plane of parent blocks
     // order is important to read voxels correctly
-    parentBlocks.reserve(numPBlocks.x * numPBlocks.y);
-    for (ushort y = 0; y < numPBlocks.y; y++)
+    parentBlocks.reserve((size_t)numPBlocks.x * numStripRows);
+    for (uint y = 0; y < numStripRows; y++)
     {
-        for (ushort x = 0; x < numPBlocks.x; x++)
+        for (uint x = 0; x < numPBlocks.x; x++)
         {
             // setup chunk world space origin for the layer this plane represents
             // chunk z starts at the instance number of this BlockPlane
-            vec3<ushort> chunkIndex = { x, y, planeID };
-            parentBlocks.emplace_back(chunkIndex * pBlockDim);
+            vec3<uint> chunkIndex = { x, y, planeID };
+            parentBlocks.emplace_back(chunkIndex * pBlockDim.cast<uint>());
         }
     }
 }
 
 // Read and store the next block plane as lines of voxels
-void BlockPlane::readBlockPlane()
+template <typename ID>
+void BlockPlane<ID>::readBlockPlane()
 {
-    //Timer timerRead("read");
+    METRICS_SPAN(currentPlane, Span::read);
 
-    // index of current parent block
-    unsigned int pBlockIndex = 0;
+    // parse every voxel's tag into a dense grid of IDs
+    slabIDs = TagReader::readTagIDs(slab.data(), slab.size(), volumeDim, tagTable);
+    numTagsRead = tagTable.getTotalTags();
+
+    storeParentBlocks();
+    
+    currentPlane++;
+}
 
-    // each voxel along z
-    for (ushort a = 0; a < pBlockDim.z; a++)
+// parent blocks only touch their own part of the grid so can be filled in parallel
+template <typename ID>
+void BlockPlane<ID>::storeParentBlocks()
+{
+    ThreadPool::shared().parallelFor(parentBlocks.size(), [this](size_t pBlockIndex)
+    {
+        storeParentBlock((uint)pBlockIndex);
+    });
+}
+
+// bytes of memory a strip needs for each row of parent blocks in it
+// its IDs, a layer of them waiting to be spilled, block indices, and an allowance for blocks and printed output
+template <typename ID>
+uint BlockPlane<ID>::getStripRows(size_t memoryBudget)
+{
+    const unsigned long long rowVoxels = (unsigned long long)volumeDim.x * pBlockDim.y * pBlockDim.z;
+    const size_t indexBytes = pBlockDim.volume() < IndexVolume<ushort>::nullIndex ? sizeof(ushort) : sizeof(uint);
+    const unsigned long long rowBytes = rowVoxels * (sizeof(ID) + indexBytes + STRIP_BLOCK_BYTES_PER_VOXEL)
+        + (unsigned long long)volumeDim.x * pBlockDim.y * sizeof(ID);
+
+    const unsigned long long stripRows = memoryBudget / rowBytes;
+    if (stripRows == 0)
     {
-        // each pBlock along y
-        for (ushort b = 0; b < numPBlocks.y; b++)
+        cerr << "A row of parent blocks needs about " << rowBytes / 1048576 + 1 << " MB, more than the memory budget, so strips will be one row\n";
+        return 1;
+    }
+
+    return (uint)min(stripRows, (unsigned long long)numPBlocks.y);
+}
+
+template <typename ID>
+uint BlockPlane<ID>::getNumStrips(uint stripRows)
+{
+    return (numPBlocks.y + stripRows - 1) / stripRows;
+}
+
+// files bigger than a long can be seeked on every platform
+template <typename ID>
+void BlockPlane<ID>::seekSpill(FILE* spill, unsigned long long offset)
+{
+#ifdef _WIN32
+    int result = _fseeki64(spill, (long long)offset, SEEK_SET);
+#else
+    int result = fseeko(spill, (off_t)offset, SEEK_SET);
+#endif
+    if (result != 0)
+    {
+        cerr << "Could not seek in the spill file\n";
+        exit(2);
+    }
+}
+
+template <typename ID>
+void BlockPlane<ID>::moveToStrip(uint plane, uint strip)
+{
+    const uint firstRow = strip * numStripRows;
+    numRowsLoaded = min(numStripRows, numPBlocks.y - firstRow);
+
+    // only the last strip of a plane is ever shorter, the next plane's first strip adds the rows back
+    const size_t numParentBlocks = (size_t)numPBlocks.x * numRowsLoaded;
+    if (parentBlocks.size() > numParentBlocks)
+        parentBlocks.erase(parentBlocks.begin() + numParentBlocks, parentBlocks.end());
+    while (parentBlocks.size() < numParentBlocks)
+        parentBlocks.emplace_back(vec3<uint>{ 0, 0, 0 });
+
+    for (size_t i = 0; i < parentBlocks.size(); i++)
+    {
+        vec3<uint> chunkIndex = { (uint)(i % numPBlocks.x), firstRow + (uint)(i / numPBlocks.x), plane };
+        parentBlocks[i].moveTo(chunkIndex * pBlockDim.cast<uint>());
+    }
+}
+
+// the input is row-major so every XY layer of the plane has a part in each strip
+// the first strip's parts go straight into the slab, the others are spilled to where their strip is kept together
+template <typename ID>
+void BlockPlane<ID>::readStrips(FILE* spill)
+{
+    METRICS_SPAN(currentPlane, Span::read);
+
+    stripPlane = currentPlane;
+    const uint numStrips = getNumStrips(numStripRows);
+    const size_t stripVoxels = (size_t)volumeDim.x * numStripRows * pBlockDim.y * pBlockDim.z;
+
+    for (ushort z = 0; z < pBlockDim.z; z++)
+    {
+        for (uint strip = 0; strip < numStrips; strip++)
         {
-            // each voxel inside pBlock y
-            for (ushort c = 0; c < pBlockDim.y; c++)
+            const uint numRows = min(numStripRows, numPBlocks.y - strip * numStripRows);
+            const size_t layerVoxels = (size_t)volumeDim.x * numRows * pBlockDim.y;
+            if (strip != 0)
+                spillRows.resize(layerVoxels);
+            ID* layer = strip == 0 ? slab.data() + z * layerVoxels : spillRows.data();
+
+            // binary input can come back inside the mapped file, which is released once read
+            const ID* read = TagReader::readTagIDs(layer, layerVoxels, volumeDim, tagTable);
+            if (read != layer)
+                memcpy(layer, read, layerVoxels * sizeof(ID));
+
+            if (strip != 0)
             {
-                // each voxel along total x
-                for (ushort d = 0; d < numPBlocks.x; d++)
+                seekSpill(spill, ((strip - 1) * stripVoxels + z * layerVoxels) * sizeof(ID));
+                if (fwrite(layer, sizeof(ID), layerVoxels, spill) != layerVoxels)
                 {
-                    // find lines of tags by breaking lines when the next tag changes
-                    // always break the line when crossing a parent block boundary
-                    ushort length = 1;
-
-                    // first tag type
-                    uchar prevID = tagTable.getID(TagReader::getNextTagName());
-
-                    // each voxel in parent block x
-                    // start at 2nd voxel
-                    for (ushort e = 1; e < pBlockDim.x; e++)
-                    {
-                        // Get next voxel description
-                        string tagName = TagReader::getNextTagName();
-                        uchar tagID = tagTable.getID(tagName);
-
-                        // if next tag is same just increase line length
-                        if (tagID == prevID)
-                        {
-                            // increase line length
-                            length++;
-                        }
-                        // else break the line and store the previous line's tag and size
-                        else
-                        {
-                            // store in a parent block
-                            parentBlocks[pBlockIndex].insertBlockLine({ (ushort)(e - length), c, a }, length, prevID);
-
-                            // reset line
-                            prevID = tagID;
-                            length = 1;
-                        }
-                    }
-
-                    // manually save final line in this parent block
-                    parentBlocks[pBlockIndex].insertBlockLine({ (ushort)(pBlockDim.x - length), c, a }, length, prevID);
-
-                    pBlockIndex++;
+                    cerr << "Could not write to the spill file\n";
+                    exit(2);
                 }
-                pBlockIndex -= numPBlocks.x;
             }
-            pBlockIndex += numPBlocks.x;
         }
-        pBlockIndex = 0;
+
+        // nothing read so far is looked at again, so a plane of mapped input is never resident at once
+        TagReader::releaseReadInput();
     }
-    
+
+    numTagsRead = tagTable.getTotalTags();
+
+    moveToStrip(stripPlane, 0);
+    slabIDs = slab.data();
+    storeParentBlocks();
+
     currentPlane++;
+}
+
+template <typename ID>
+void BlockPlane<ID>::loadStrip(FILE* spill, uint strip)
+{
+    METRICS_SPAN(stripPlane, Span::read);
+
+    moveToStrip(stripPlane, strip);
 
-    //timerRead.print();
+    const size_t stripVoxels = (size_t)volumeDim.x * numStripRows * pBlockDim.y * pBlockDim.z;
+    const size_t numVoxels = (size_t)volumeDim.x * numRowsLoaded * pBlockDim.y * pBlockDim.z;
+    seekSpill(spill, (strip - 1) * stripVoxels * sizeof(ID));
+    if (fread(slab.data(), sizeof(ID), numVoxels, spill) != numVoxels)
+    {
+        cerr << "Could not read back the spill file\n";
+        exit(2);
+    }
+
+    slabIDs = slab.data();
+    storeParentBlocks();
+}
+
+// Store a parent block's part of the grid as lines of voxels
+template <typename ID>
+void BlockPlane<ID>::storeParentBlock(uint pBlockIndex)
+{
+    ParentBlock& parentBlock = parentBlocks[pBlockIndex];
+
+    // distance between rows and XY planes of voxels in the grid
+    const size_t rowStride = volumeDim.x;
+    const size_t planeStride = (size_t)volumeDim.x * numRowsLoaded * pBlockDim.y;
+
+    // first voxel of the parent block
+    const size_t pBlockX = pBlockIndex % numPBlocks.x;
+    const size_t pBlockY = pBlockIndex / numPBlocks.x;
+    const ID* origin = slabIDs + pBlockX * pBlockDim.x + pBlockY * pBlockDim.y * rowStride;
+
+    if constexpr (is_same_v<ID, ushort>)
+    {
+        if (!parentBlock.storeVoxels(origin, rowStride, planeStride))
+        {
+            cerr << "Parent block at " << parentBlock.getOrigin().to_string() << " has more than 256 different tags\n";
+            exit(2);
+        }
+    }
+    else
+        parentBlock.storeVoxels(origin, rowStride, planeStride);
 }
 
 // Read voxel description forwards to get tag
-inline string BlockPlane::getTagFromChars(char* start)
+template <typename ID>
+inline string BlockPlane<ID>::getTagFromChars(char* start)
 {
     // index 6 is the first place the ' symbol might appear
     start += 6;
@@ -177,26 +285,67 @@ inline string BlockPlane::getTagFromChars(char* start)
     return string(start, end - start);
 }
 
-// Print all blocks in parentBlocks
-void BlockPlane::printBlockPlane()
+// Compress and print all blocks in parentBlocks into their own buffers
+template <typename ID>
+void BlockPlane<ID>::compressBlockPlane()
+{
+    // parent blocks are independent so use every thread
+    ThreadPool::shared().parallelFor(parentBlocks.size(), [this](size_t pBlockIndex)
+    {
+        parentBlocks[pBlockIndex].compressPrint();
+    });
+}
+
+// Write the printed blocks of every parent block and prepare for the next plane this instance will read
+template <typename ID>
+void BlockPlane<ID>::writeBlockPlane()
 {
-    //Timer timerWrite("write", true);
+    METRICS_SPAN(parentBlocks[0].getOrigin().z / pBlockDim.z, Span::write);
 
-    // Print all blocks
+    // binary output names each tag once before the first block using it
+    if (outputFormat == OutputFormat::binary)
+    {
+        BlockWriter writer;
+
+        if (numTagsWritten == -1)
+        {
+            BinaryFormat::writeHeader(writer, volumeDim.cast<ushort>(), pBlockDim);
+            numTagsWritten = 0;
+        }
+
+        // every tag in this plane was added while reading it
+        // the read stage may be adding later planes' tags, so only names counted when this plane was handed over are safe to read
+        if (numTagsRead > numTagsWritten)
+        {
+            BinaryFormat::writeTags(writer, tagTable, numTagsWritten, numTagsRead - numTagsWritten);
+            numTagsWritten = numTagsRead;
+        }
+
+        OutputStream::write(writer.data(), writer.size());
+    }
+
+    // write buffers in parent block order so output matches a serial run
     for (auto& parentBlock : parentBlocks)
     {
-        // use compression and print this block
-        parentBlock.compressPrint();
+        const BlockWriter& output = parentBlock.getOutput();
+        OutputStream::write(output.data(), output.size());
+        numBlocksWritten += parentBlock.getNumBlocks();
+        METRICS_COUNT(parentBlock.getOrigin().z / pBlockDim.z, Counter::blocksWritten, parentBlock.getNumBlocks());
 
         // reset storage and increment parentBlock z position ready for next BlockPlane
         parentBlock.reset(numInstances);
     }
+}
 
-    //timerWrite.print();
+template <typename ID>
+unsigned long long BlockPlane<ID>::getNumBlocksWritten()
+{
+    return numBlocksWritten;
 }
 
 // check if all planes have been read
-bool BlockPlane::canRead()
+template <typename ID>
+bool BlockPlane<ID>::canRead()
 {
     // If we have done all planes, return exit flag
     if (currentPlane >= numPBlocks.z)
@@ -214,7 +363,98 @@ bool BlockPlane::canRead()
     return true;
 }
 
-bool BlockPlane::canUseOnePlane()
+// Write anything that comes after the last plane
+template <typename ID>
+void BlockPlane<ID>::finishOutput()
+{
+    if (outputFormat == OutputFormat::binary)
+    {
+        BlockWriter writer;
+        BinaryFormat::writeEnd(writer);
+        OutputStream::write(writer.data(), writer.size());
+    }
+
+    OutputStream::flush();
+}
+
+// number of planes of parent blocks in the volume
+template <typename ID>
+uint BlockPlane<ID>::getNumPlanes()
+{
+    return numPBlocks.z;
+}
+
+template <typename ID>
+bool BlockPlane<ID>::canUseOnePlane()
 {
     return pBlockDim.z == volumeDim.z;
 }
+
+// convert the rest of the input to the binary voxel format
+// tags are only all known at the end so IDs wait in a temporary file until the dictionary has been written
+template <typename ID>
+void BlockPlane<ID>::convertToBinary()
+{
+    FILE* spill = tmpfile();
+    if (spill == nullptr)
+    {
+        cerr << "Could not create a temporary file\n";
+        exit(2);
+    }
+
+    vector<ID> ids((size_t)volumeDim.x * volumeDim.y * pBlockDim.z);
+    for (uint plane = 0; plane < numPBlocks.z; plane++)
+    {
+        const ID* planeIDs = TagReader::readTagIDs(ids.data(), ids.size(), volumeDim, tagTable);
+        fwrite(planeIDs, sizeof(ID), ids.size(), spill);
+    }
+
+    BlockWriter header;
+    VoxelFormat::writeHeader(header, volumeDim, pBlockDim, tagTable);
+    OutputStream::write(header.data(), header.size());
+
+    // copy the IDs in behind the dictionary, little-endian and as wide as the number of tags needs rather than the table used
+    const size_t idBytes = VoxelFormat::needsWideIDs(tagTable.getTotalTags()) ? 2 : 1;
+    vector<uchar> bytes(sizeof(ID) == 1 ? 0 : ids.size() * idBytes);
+
+    rewind(spill);
+    size_t numRead;
+    while ((numRead = fread(ids.data(), sizeof(ID), ids.size(), spill)) != 0)
+    {
+        if (bytes.empty())
+        {
+            OutputStream::write((const char*)ids.data(), numRead * sizeof(ID));
+            continue;
+        }
+
+        for (size_t i = 0; i < numRead; i++)
+        {
+            bytes[i * idBytes] = (uchar)(ids[i] & 0xFF);
+            if (idBytes == 2)
+                bytes[i * idBytes + 1] = (uchar)(ids[i] >> 8);
+        }
+        OutputStream::write((const char*)bytes.data(), numRead * idBytes);
+    }
+
+    OutputStream::flush();
+    fclose(spill);
+}
+
+// the input lists changed voxels rather than the whole volume
+template <typename ID>
+void BlockPlane<ID>::updateOutput(const string& oldOutputPath)
+{
+    // old output is rebuilt a parent block at a time with uchar IDs
+    if constexpr (sizeof(ID) == 1)
+    {
+        OutputUpdater::run(oldOutputPath, volumeDim.cast<ushort>(), pBlockDim, tagTable);
+    }
+    else
+    {
+        cerr << "--update only works with models of up to 256 tags\n";
+        exit(2);
+    }
+}
+
+template class BlockPlane<uchar>;
+template class BlockPlane<ushort>;
@@ -10,33 +10,63 @@
 #include "ParentBlock.h"
 #include "TagTable.h"
 #include "vec3.h"
-#include "Timer.h"
+#include "ThreadPool.h"
+#include "OutputStream.h"
+#include "VoxelFormat.h"
+#include "OutputUpdater.h"
 #include "uDataTypes.h"
 
 using namespace std;
 
+// ID is uchar for models with up to 256 tags and ushort for more
+// volume coordinates are always 32 bit, they are only used to place parent blocks so cost nothing per voxel
+template <typename ID>
 class BlockPlane
 {
 private:
-    static TagTable tagTable;                           // stores global ID for each possible tag
-    static vec3<ushort> volumeDim;                      // how many voxels fit in volume per dimension
+    static BasicTagTable<ID> tagTable;                  // stores global ID for each possible tag
+    static vec3<uint> volumeDim;                        // how many voxels fit in volume per dimension
     static vec3<ushort> pBlockDim;                      // how many voxels fit in a parent-block per dimension
-    static vec3<ushort> numPBlocks;                     // how many Parent-blocks fit in volume per dimension
-    static ushort currentPlane;                         // which XY plane (of parent blocks) is next to read
-    static ushort numInstances;                         // number of instances of BlockPlane
-    static void readDimensions();                       // read dimensions to be used in creating BlockPlanes/ParentBlocks
+    static vec3<uint> numPBlocks;                       // how many Parent-blocks fit in volume per dimension
+    static uint currentPlane;                           // which XY plane (of parent blocks) is next to read
+    static uint numInstances;                           // number of instances of BlockPlane
+    static OutputFormat outputFormat;                   // whether blocks are written as text or binary
+    static int numTagsWritten;                          // tags already named in binary output
+    static unsigned long long numBlocksWritten;         // blocks written by every plane so far
     static string getTagFromChars(char* start);         // Get the tag from a input voxel description string
 
     vector<ParentBlock> parentBlocks;                   // vector of parent blocks
-    ushort planeID;                                     // this BlockPlane's instance ID             
+    vector<ID> slab;                                    // tag ID of every voxel in the plane, row-major
+    const ID* slabIDs;                                  // where the plane's IDs were read to, the slab or the mapped input
+    uint planeID;                                       // this BlockPlane's instance ID
+    int numTagsRead;                                    // tags in the table once this plane was read, all its IDs are below it
+    uint numStripRows;                                  // rows of parent blocks held, all of a plane's unless it is read in strips
+    uint numRowsLoaded;                                 // rows of parent blocks in the slab, the last strip of a plane can be shorter
+    uint stripPlane;                                    // plane of parent blocks the strips being processed are from
+    vector<ID> spillRows;                               // one XY layer of a strip on its way to the spill file
     void createParentBlocks();                          // allocate memory for this BlockPlane's ParentBlocks
+    void storeParentBlock(uint pBlockIndex);            // split a parent block's voxels into lines
+    void storeParentBlocks();
+    void moveToStrip(uint plane, uint strip);           // place the parent blocks over a strip, dropping or adding a row's worth as needed
+    static void seekSpill(FILE* spill, unsigned long long offset);
 
 public:
-    static void setup();                                // call functions that prepare BlockPlane for use
+    static void setup(OutputFormat format, vec3<uint> volumeSize, vec3<ushort> pBlockSize);  // sizes come from TagReader's description
     static bool canRead();                              // check whether there are more block planes to be read
     static bool canUseOnePlane();                       // checks whether 1 plane of parent blocks covers entire volume
+    static uint getNumPlanes();                         // number of planes of parent blocks in the volume
+    static void finishOutput();                         // write anything after the last plane and flush
+    static unsigned long long getNumBlocksWritten();
+    static void convertToBinary();                      // write the remaining input in the binary voxel format
+    static void updateOutput(const string& oldOutputPath);  // recompress parent blocks of old output touched by changes in the input
+    static uint getStripRows(size_t memoryBudget);      // rows of parent blocks in a strip that fits in the budget, at least 1
+    static uint getNumStrips(uint stripRows);
 
     BlockPlane();
-    void printBlockPlane();
+    BlockPlane(uint stripRows);                         // holds a strip of rows of parent blocks instead of a whole plane
     void readBlockPlane();
+    void readStrips(FILE* spill);                       // read the next plane once, keeping its first strip and spilling the rest
+    void loadStrip(FILE* spill, uint strip);            // bring back a strip spilled by readStrips
+    void compressBlockPlane();
+    void writeBlockPlane();
 };
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "vec3.h"
+#include "uDataTypes.h"
+
+using namespace std;
+
+// how blocks are written out
+enum class OutputFormat { text, binary };
+
+// formats blocks as lines of text, or packed binary records, into a reusable buffer
+class BlockWriter
+{
+private:
+	vector<char> buffer;
+	size_t used = 0;
+
+	char* reserve(size_t length);
+	static char* writeNumber(char* c, uint value);
+	static char* writeBinaryUShort(char* c, ushort value);
+
+public:
+	void writeBlock(vec3<uint> position, vec3<ushort> size, const string& quotedTag);
+	void writeBinaryBlock(vec3<ushort> origin, vec3<ushort> size, uchar ID);
+	void writeByte(uchar value);
+	void writeUShort(ushort value);
+	void writeUInt(uint value);
+	void writeChars(const char* chars, size_t length);
+	void clear();
+	const char* data() const;
+	size_t size() const;
+};
+
+// make room for at least 'length' more chars and return where they go
+inline char* BlockWriter::reserve(size_t length)
+{
+	if (buffer.size() - used < length)
+		buffer.resize(max(buffer.size() * 2, used + length));
+
+	return buffer.data() + used;
+}
+
+inline char* BlockWriter::writeNumber(char* c, uint value)
+{
+	// a uint never needs more than 10 digits
+	return to_chars(c, c + 10, value).ptr;
+}
+
+// write "x,y,z,sizeX,sizeY,sizeZ,'tag'" on its own line
+// tag is passed already surrounded by quotes
+inline void BlockWriter::writeBlock(vec3<uint> position, vec3<ushort> size, const string& quotedTag)
+{
+	// 6 numbers and their commas, then the tag and new line
+	char* c = reserve(3 * 11 + 3 * 6 + quotedTag.size() + 1);
+
+	c = writeNumber(c, position.x); *c++ = ',';
+	c = writeNumber(c, position.y); *c++ = ',';
+	c = writeNumber(c, position.z); *c++ = ',';
+	c = writeNumber(c, size.x); *c++ = ',';
+	c = writeNumber(c, size.y); *c++ = ',';
+	c = writeNumber(c, size.z); *c++ = ',';
+
+	memcpy(c, quotedTag.data(), quotedTag.size());
+	c += quotedTag.size();
+	*c++ = '\n';
+
+	used = c - buffer.data();
+}
+
+// little-endian regardless of the machine
+inline char* BlockWriter::writeBinaryUShort(char* c, ushort value)
+{
+	*c++ = (char)(value & 0xFF);
+	*c++ = (char)(value >> 8);
+	return c;
+}
+
+// write a block as 6 ushorts and its tag ID, origin is relative to its parent block
+inline void BlockWriter::writeBinaryBlock(vec3<ushort> origin, vec3<ushort> size, uchar ID)
+{
+	char* c = reserve(6 * sizeof(ushort) + 1);
+
+	c = writeBinaryUShort(c, origin.x);
+	c = writeBinaryUShort(c, origin.y);
+	c = writeBinaryUShort(c, origin.z);
+	c = writeBinaryUShort(c, size.x);
+	c = writeBinaryUShort(c, size.y);
+	c = writeBinaryUShort(c, size.z);
+	*c++ = (char)ID;
+
+	used = c - buffer.data();
+}
+
+inline void BlockWriter::writeByte(uchar value)
+{
+	*reserve(1) = (char)value;
+	used++;
+}
+
+inline void BlockWriter::writeUShort(ushort value)
+{
+	writeBinaryUShort(reserve(2), value);
+	used += 2;
+}
+
+inline void BlockWriter::writeUInt(uint value)
+{
+	writeUShort((ushort)(value & 0xFFFF));
+	writeUShort((ushort)(value >> 16));
+}
+
+inline void BlockWriter::writeChars(const char* chars, size_t length)
+{
+	memcpy(reserve(length), chars, length);
+	used += length;
+}
+
+// forget written blocks but keep the memory for reuse
+inline void BlockWriter::clear()
+{
+	used = 0;
+}
+
+inline const char* BlockWriter::data() const
+{
+	return buffer.data();
+}
+
+inline size_t BlockWriter::size() const
+{
+	return used;
+}
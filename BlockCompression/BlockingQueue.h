@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+// fixed capacity queue for handing work between threads
+// push waits while the queue is full and pop waits while it is empty
+template<typename T>
+class BlockingQueue
+{
+private:
+	deque<T> items;
+	size_t capacity;
+	mutex queueMutex;
+	condition_variable changed;
+
+public:
+	BlockingQueue(size_t _capacity) : capacity(_capacity)
+	{
+	}
+
+	void push(T item)
+	{
+		{
+			unique_lock<mutex> lock(queueMutex);
+			changed.wait(lock, [this] { return items.size() < capacity; });
+			items.push_back(move(item));
+		}
+
+		changed.notify_all();
+	}
+
+	T pop()
+	{
+		T item;
+
+		{
+			unique_lock<mutex> lock(queueMutex);
+			changed.wait(lock, [this] { return !items.empty(); });
+			item = move(items.front());
+			items.pop_front();
+		}
+
+		changed.notify_all();
+		return item;
+	}
+};
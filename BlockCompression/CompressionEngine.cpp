@@ -0,0 +1,50 @@
+#include "CompressionEngine.h"
+
+#include <cstring>
+#include "GreedyEngine.h"
+#include "MaximalBoxEngine.h"
+#include "ParentBlock.h"
+
+const CompressionEngine* CompressionEngine::create(const string& name)
+{
+    static const GreedyEngine greedy;
+    static const MaximalBoxEngine maximalBox;
+
+    if (name == greedy.getName())
+        return &greedy;
+    if (name == maximalBox.getName())
+        return &maximalBox;
+
+    return nullptr;
+}
+
+const CompressionEngine* CompressionEngine::getDefault()
+{
+    return create("greedy");
+}
+
+const char* CompressionEngine::getNames()
+{
+    return "greedy, maxbox";
+}
+
+// paint each block's ID over a row-major grid the size of a parent block
+void CompressionEngine::expandBlocks(ParentBlock& parentBlock, vector<uchar>& ids)
+{
+    const vec3<ushort> pBlockDim = parentBlock.getDimensions();
+    const size_t rowStride = pBlockDim.x;
+    const size_t planeStride = (size_t)pBlockDim.x * pBlockDim.y;
+    const BlockList& blocks = parentBlock.getBlocks();
+
+    ids.resize(planeStride * pBlockDim.z);
+    blocks.forEachValid([&](uint block)
+    {
+        const SubVolume& subVolume = blocks.subVolumes[block];
+        for (ushort z = 0; z < subVolume.size.z; z++)
+            for (ushort y = 0; y < subVolume.size.y; y++)
+            {
+                uchar* row = ids.data() + subVolume.origin.x + (subVolume.origin.y + y) * rowStride + (subVolume.origin.z + z) * planeStride;
+                memset(row, blocks.IDs[block], subVolume.size.x);
+            }
+    });
+}
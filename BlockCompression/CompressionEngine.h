@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "uDataTypes.h"
+
+using namespace std;
+
+class ParentBlock;
+
+// a way of merging the lines stored in a parent block into as few blocks as it can
+// engines hold no state between parent blocks so one is shared by every thread
+class CompressionEngine
+{
+protected:
+	static void expandBlocks(ParentBlock& parentBlock, vector<uchar>& ids);	// tag ID of every voxel from the parent block's valid blocks
+
+public:
+	virtual ~CompressionEngine() = default;
+
+	virtual const char* getName() const = 0;
+
+	// replace the lines in the parent block's block list with compressed blocks
+	// only called for parent blocks containing more than one tag
+	virtual void compress(ParentBlock& parentBlock) const = 0;
+
+	static const CompressionEngine* create(const string& name);	// null for an unknown name
+	static const CompressionEngine* getDefault();
+	static const char* getNames();							// every engine name, for usage messages
+};
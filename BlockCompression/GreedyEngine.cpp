@@ -0,0 +1,13 @@
+#include "GreedyEngine.h"
+
+#include "ParentBlock.h"
+
+const char* GreedyEngine::getName() const
+{
+    return "greedy";
+}
+
+void GreedyEngine::compress(ParentBlock& parentBlock) const
+{
+    parentBlock.greedyShelfCompress();
+}
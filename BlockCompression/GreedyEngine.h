@@ -0,0 +1,12 @@
+#pragma once
+
+#include "CompressionEngine.h"
+
+// the original engine, merges lines along Y then Z and then removes single shelves
+// fast and usually close to the fewest blocks
+class GreedyEngine : public CompressionEngine
+{
+public:
+	const char* getName() const override;
+	void compress(ParentBlock& parentBlock) const override;
+};
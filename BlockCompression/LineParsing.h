@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstring>
+
+// helpers for walking lines of "x,y,z,sizeX,sizeY,sizeZ,'tag'" text
+
+// find the start of the first line after 'c', or 'end' if there is none
+static inline const char* nextLineStart(const char* c, const char* end)
+{
+	const char* newLine = (const char*)memchr(c, '\n', end - c);
+	return newLine == nullptr ? end : newLine + 1;
+}
+
+// read the next number in a voxel or block description
+static inline bool parseCoordinate(const char*& c, const char* end, unsigned long long& value)
+{
+	while (c < end && (*c < '0' || *c > '9'))
+	{
+		// reached the tag without finding a number
+		if (*c == '\'')
+			return false;
+		c++;
+	}
+
+	if (c == end)
+		return false;
+
+	value = 0;
+	while (c < end && *c >= '0' && *c <= '9')
+	{
+		value = value * 10 + (*c - '0');
+		c++;
+	}
+
+	return true;
+}
@@ -0,0 +1,211 @@
+#include "MaximalBoxEngine.h"
+
+#include <algorithm>
+#include <cstring>
+#include "ParentBlock.h"
+
+// boxes grown per greedy block before giving up on a parent block and keeping the greedy blocks
+// wins on the test models all came within 4, unlimited searches cost twice as long for a handful more
+#define MAX_ATTEMPTS_PER_BLOCK 4
+
+// a thread keeps its workspace for parent blocks up to 64^3, about 10 MB, and frees it after bigger ones
+#define KEEP_WORKSPACE_VOXELS (64 * 64 * 64)
+
+// every order the three axes can be grown in
+static const int AXIS_ORDERS[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+
+const char* MaximalBoxEngine::getName() const
+{
+    return "maxbox";
+}
+
+// whether no voxel inside [low, high) is part of a box yet
+inline bool MaximalBoxEngine::isUncovered(const Workspace& work, const uint* low, const uint* high)
+{
+    for (uint z = low[2]; z < high[2]; z++)
+    {
+        for (uint y = low[1]; y < high[1]; y++)
+        {
+            const uchar* row = work.covered.data() + (z * work.axisSize[1] + y) * work.axisSize[0];
+            if (memchr(row + low[0], 1, high[0] - low[0]) != nullptr)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// length of the same tag run starting at each voxel along each axis, by walking back from the far end
+void MaximalBoxEngine::buildRuns(Workspace& work)
+{
+    const size_t strides[3] = { 1, work.axisSize[0], (size_t)work.axisSize[0] * work.axisSize[1] };
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        vector<ushort>& runs = work.runs[axis];
+        runs.resize(work.ids.size());
+
+        for (size_t voxel = work.ids.size(); voxel-- > 0;)
+        {
+            const uint position = (uint)(voxel / strides[axis] % work.axisSize[axis]);
+            const bool continues = position + 1 < work.axisSize[axis] && work.ids[voxel + strides[axis]] == work.ids[voxel];
+            runs[voxel] = continues ? runs[voxel + strides[axis]] + 1 : 1;
+        }
+    }
+}
+
+// grow a box from [low, high) one axis at a time in the given order, while each new slice is uncovered and the box stays one tag
+// returns the volume of the grown box
+unsigned long long MaximalBoxEngine::growBox(const Workspace& work, const int* order, uint* low, uint* high)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        const int axis = order[i];
+
+        while (high[axis] < work.axisSize[axis])
+        {
+            uint sliceLow[3] = { low[0], low[1], low[2] };
+            uint sliceHigh[3] = { high[0], high[1], high[2] };
+            sliceLow[axis] = high[axis];
+            sliceHigh[axis] = high[axis] + 1;
+
+            if (!work.tagEdges.isOneTag(low, sliceHigh) || (work.anyCovered && !isUncovered(work, sliceLow, sliceHigh)))
+                break;
+
+            high[axis]++;
+        }
+    }
+
+    return (unsigned long long)(high[0] - low[0]) * (high[1] - low[1]) * (high[2] - low[2]);
+}
+
+// biggest box with its lowest corner at an uncovered voxel, over every order of axes
+unsigned long long MaximalBoxEngine::growBestBox(const Workspace& work, uint voxel, uint* low, uint* high)
+{
+    const uint x = voxel % work.axisSize[0];
+    const uint y = voxel / work.axisSize[0] % work.axisSize[1];
+    const uint z = voxel / work.axisSize[0] / work.axisSize[1];
+
+    // the seed voxel on its own is always a box
+    low[0] = x, low[1] = y, low[2] = z;
+    high[0] = x + 1, high[1] = y + 1, high[2] = z + 1;
+
+    unsigned long long bestVolume = 0;
+    for (const int* order : AXIS_ORDERS)
+    {
+        uint orderLow[3] = { x, y, z };
+        uint orderHigh[3] = { x + 1, y + 1, z + 1 };
+
+        unsigned long long volume = growBox(work, order, orderLow, orderHigh);
+        if (volume > bestVolume)
+        {
+            bestVolume = volume;
+            copy(orderLow, orderLow + 3, low);
+            copy(orderHigh, orderHigh + 3, high);
+        }
+    }
+
+    return bestVolume;
+}
+
+void MaximalBoxEngine::compress(ParentBlock& parentBlock) const
+{
+    thread_local Workspace work;
+    placeBoxes(parentBlock, work);
+
+    if (work.ids.size() > KEEP_WORKSPACE_VOXELS)
+        work = Workspace();
+}
+
+void MaximalBoxEngine::placeBoxes(ParentBlock& parentBlock, Workspace& work)
+{
+    const vec3<ushort> pBlockDim = parentBlock.getDimensions();
+    work.axisSize[0] = pBlockDim.x;
+    work.axisSize[1] = pBlockDim.y;
+    work.axisSize[2] = pBlockDim.z;
+    const size_t rowStride = pBlockDim.x;
+    const size_t planeStride = (size_t)pBlockDim.x * pBlockDim.y;
+
+    BlockList& blocks = parentBlock.getBlocks();
+    expandBlocks(parentBlock, work.ids);
+
+    // the greedy blocks are kept unless boxes do better, so this engine never loses to it
+    parentBlock.greedyShelfCompress();
+    const size_t greedyBlocks = blocks.countValid();
+
+    // every tag needs a box of its own, so greedy cannot be beaten when it has one block per tag
+    work.tagEdges.build(work.ids, work.axisSize);
+    if (greedyBlocks <= work.tagEdges.getNumTags())
+        return;
+
+    work.covered.assign(work.ids.size(), 0);
+    work.anyCovered = false;
+    work.boxes.clear();
+
+    // lower volumes sort first so the heap pops the biggest box, ties go to the first voxel
+    auto smallerBox = [](const pair<unsigned long long, uint>& a, const pair<unsigned long long, uint>& b)
+    {
+        return a.first < b.first || (a.first == b.first && a.second > b.second);
+    };
+
+    // no box from a voxel can be longer on any axis than the run starting there
+    buildRuns(work);
+    work.seeds.clear();
+    for (uint voxel = 0; voxel < work.ids.size(); voxel++)
+    {
+        const unsigned long long bound = (unsigned long long)work.runs[0][voxel] * work.runs[1][voxel] * work.runs[2][voxel];
+        work.seeds.push_back({ bound, voxel });
+    }
+    make_heap(work.seeds.begin(), work.seeds.end(), smallerBox);
+
+    // a voxel's box is placed once it is at least as big as any other voxel could still manage,
+    // otherwise it goes back in the heap with the volume it really has
+    // boxes that are not the biggest left are tried again, give up once that happens too often to keep the cost bounded
+    const size_t maxAttempts = greedyBlocks * MAX_ATTEMPTS_PER_BLOCK;
+    size_t numAttempts = 0;
+    unsigned long long numUncovered = work.ids.size();
+    while (!work.seeds.empty() && work.boxes.size() < greedyBlocks)
+    {
+        // no box left can be bigger than the top of the heap, stop once even boxes that big could not beat greedy
+        const unsigned long long biggestBox = work.seeds.front().first;
+        if (work.boxes.size() + (numUncovered + biggestBox - 1) / biggestBox >= greedyBlocks)
+            break;
+
+        pop_heap(work.seeds.begin(), work.seeds.end(), smallerBox);
+        const uint voxel = work.seeds.back().second;
+        work.seeds.pop_back();
+
+        if (work.covered[voxel])
+            continue;
+
+        if (++numAttempts > maxAttempts)
+            break;
+
+        uint low[3], high[3];
+        unsigned long long volume = growBestBox(work, voxel, low, high);
+        if (!work.seeds.empty() && smallerBox({ volume, voxel }, work.seeds.front()))
+        {
+            work.seeds.push_back({ volume, voxel });
+            push_heap(work.seeds.begin(), work.seeds.end(), smallerBox);
+            continue;
+        }
+
+        work.anyCovered = true;
+        for (uint z = low[2]; z < high[2]; z++)
+            for (uint y = low[1]; y < high[1]; y++)
+                memset(work.covered.data() + z * planeStride + y * rowStride + low[0], 1, high[0] - low[0]);
+
+        work.boxes.push_back({ voxel, high[0] - low[0], high[1] - low[1], high[2] - low[2] });
+        numUncovered -= volume;
+    }
+
+    if (!work.seeds.empty() || work.boxes.size() >= greedyBlocks)
+        return;
+
+    blocks.clear();
+    for (const Box& box : work.boxes)
+    {
+        const vec3<ushort> origin = { (ushort)(box.voxel % rowStride), (ushort)(box.voxel / rowStride % pBlockDim.y), (ushort)(box.voxel / planeStride) };
+        blocks.push(origin, { (ushort)box.size[0], (ushort)box.size[1], (ushort)box.size[2] }, work.ids[box.voxel], box.voxel);
+    }
+}
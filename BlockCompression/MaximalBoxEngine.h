@@ -0,0 +1,50 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "CompressionEngine.h"
+#include "TagEdges.h"
+#include "vec3.h"
+#include "uDataTypes.h"
+
+// places the biggest box it can find first, growing one from a voxel in each order of axes
+// 3D prefix counts of where tags change tell whether a box is all one tag without reading it
+// voxels are tried in order of how big a box they could start, so most are covered before they are ever grown
+// the greedy engine runs first and its blocks are kept whenever the boxes are not fewer
+// slower than the greedy engine, but large boxes are never split by the order voxels are visited in
+// the search gives up on a parent block after growing 4 boxes per greedy block, so it costs at most a bounded multiple of greedy
+// that is still 10-25 times greedy's time on large models, for usually well under 1% fewer blocks
+// each thread keeps a workspace of about 40 bytes per parent block voxel, freed after parent blocks bigger than 64^3
+class MaximalBoxEngine : public CompressionEngine
+{
+private:
+	// a placed box, by the voxel at its lowest corner
+	struct Box
+	{
+		uint voxel;
+		uint size[3];
+	};
+
+	// scratch space reused by each thread between parent blocks
+	struct Workspace
+	{
+		vector<uchar> ids;				// tag ID of every voxel
+		vector<uchar> covered;			// whether a voxel is inside a box already
+		TagEdges tagEdges;
+		uint axisSize[3];
+		bool anyCovered;				// no voxel needs checking until the first box is placed
+		vector<ushort> runs[3];			// same tag voxels from each voxel to the end of its row along each axis
+		vector<pair<unsigned long long, uint>> seeds;	// heap of the most volume a box from each voxel could have
+		vector<Box> boxes;
+	};
+
+	static bool isUncovered(const Workspace& work, const uint* low, const uint* high);
+	static void buildRuns(Workspace& work);
+	static unsigned long long growBox(const Workspace& work, const int* order, uint* low, uint* high);
+	static unsigned long long growBestBox(const Workspace& work, uint voxel, uint* low, uint* high);
+	static void placeBoxes(ParentBlock& parentBlock, Workspace& work);
+
+public:
+	const char* getName() const override;
+	void compress(ParentBlock& parentBlock) const override;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+using namespace std;
+
+// how much memory the process has used, for reporting alongside timings
+class MemoryUsage
+{
+public:
+	static unsigned long long getPeakBytes();	// most resident memory at any time so far, 0 if the OS cannot say
+};
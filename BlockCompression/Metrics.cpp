@@ -0,0 +1,88 @@
+#include "Metrics.h"
+
+#include <fstream>
+#include <iostream>
+#include "MemoryUsage.h"
+#include "ThreadPool.h"
+
+bool Metrics::enabled = false;
+vector<unique_ptr<Metrics::Plane>> Metrics::planes;
+chrono::steady_clock::time_point Metrics::startTime;
+
+static const char* SPAN_NAMES[] = { "read", "greedy", "refresh_indices", "shelf", "print", "write" };
+static const char* COUNTER_NAMES[] = { "voxels", "runs", "blocks_after_greedy", "blocks_after_shelf", "blocks_written" };
+
+// start collecting, planes are numbered by their Z position in parent blocks
+void Metrics::setup(uint numPlanes)
+{
+    planes.clear();
+    for (uint i = 0; i < numPlanes; i++)
+        planes.push_back(make_unique<Plane>());
+
+    startTime = chrono::steady_clock::now();
+    enabled = true;
+}
+
+// "spans" in seconds and "counters" of one plane or the total
+static void writeEntry(ostream& out, const uint64_t* spanNanoseconds, const uint64_t* counters, bool withThroughput)
+{
+    out << "\"spans\": {";
+    for (int span = 0; span < (int)Span::count; span++)
+        out << (span == 0 ? "" : ", ") << "\"" << SPAN_NAMES[span] << "\": " << spanNanoseconds[span] / 1e9;
+
+    out << "}, \"counters\": {";
+    for (int counter = 0; counter < (int)Counter::count; counter++)
+        out << (counter == 0 ? "" : ", ") << "\"" << COUNTER_NAMES[counter] << "\": " << counters[counter];
+    out << "}";
+
+    // voxels each span gets through per second of its time
+    if (withThroughput)
+    {
+        out << ", \"voxels_per_second\": {";
+        for (int span = 0; span < (int)Span::count; span++)
+        {
+            double seconds = spanNanoseconds[span] / 1e9;
+            out << (span == 0 ? "" : ", ") << "\"" << SPAN_NAMES[span] << "\": " << (seconds > 0 ? counters[(int)Counter::voxels] / seconds : 0);
+        }
+        out << "}";
+    }
+}
+
+void Metrics::writeJSON(const string& path)
+{
+    if (!enabled)
+        return;
+
+    ofstream out(path);
+    if (!out)
+    {
+        cerr << "Could not write metrics to " << path << "\n";
+        exit(2);
+    }
+
+    uint64_t totalSpans[NUM_SPANS] = {};
+    uint64_t totalCounters[NUM_COUNTERS] = {};
+
+    out << "{\n  \"wall_seconds\": " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << ",\n";
+    out << "  \"threads\": " << ThreadPool::shared().getNumThreads() << ",\n";
+    out << "  \"peak_rss_bytes\": " << MemoryUsage::getPeakBytes() << ",\n";
+    out << "  \"planes\": [\n";
+
+    for (size_t i = 0; i < planes.size(); i++)
+    {
+        uint64_t spans[NUM_SPANS];
+        uint64_t counters[NUM_COUNTERS];
+        for (int span = 0; span < NUM_SPANS; span++)
+            totalSpans[span] += spans[span] = planes[i]->spanNanoseconds[span];
+        for (int counter = 0; counter < NUM_COUNTERS; counter++)
+            totalCounters[counter] += counters[counter] = planes[i]->counters[counter];
+
+        out << "    {\"plane\": " << i << ", ";
+        writeEntry(out, spans, counters, false);
+        out << (i + 1 < planes.size() ? "},\n" : "}\n");
+    }
+
+    out << "  ],\n  \"total\": {";
+    writeEntry(out, totalSpans, totalCounters, true);
+    out << "}\n}\n";
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "uDataTypes.h"
+
+using namespace std;
+
+// timed sections of the hot path, times from parallel sections are summed over every thread
+enum class Span { read, greedy, refreshIndices, shelf, print, write, count };
+
+// things counted on the hot path
+// blocks after greedy and shelving only count parent blocks compressed by the greedy kernels
+enum class Counter { voxels, runs, blocksAfterGreedy, blocksAfterShelf, blocksWritten, count };
+
+// per plane and total times and counts of the stages, written as JSON when the run finishes
+// only collects anything after setup, and compiles to nothing unless ENABLE_METRICS is defined
+class Metrics
+{
+private:
+	static constexpr int NUM_SPANS = (int)Span::count;
+	static constexpr int NUM_COUNTERS = (int)Counter::count;
+
+	// parent blocks of one plane are compressed in parallel so everything is atomic
+	struct Plane
+	{
+		atomic<uint64_t> spanNanoseconds[NUM_SPANS] = {};
+		atomic<uint64_t> counters[NUM_COUNTERS] = {};
+	};
+
+	static bool enabled;
+	static vector<unique_ptr<Plane>> planes;
+	static chrono::steady_clock::time_point startTime;
+
+public:
+	static void setup(uint numPlanes);
+	static bool isEnabled() { return enabled; }
+
+	static void count(uint plane, Counter counter, uint64_t amount)
+	{
+		planes[plane]->counters[(int)counter].fetch_add(amount, memory_order_relaxed);
+	}
+
+	static void addTime(uint plane, Span span, uint64_t nanoseconds)
+	{
+		planes[plane]->spanNanoseconds[(int)span].fetch_add(nanoseconds, memory_order_relaxed);
+	}
+
+	static void writeJSON(const string& path);
+
+	// adds the time from construction to destruction to a span, reads no clock when metrics are off
+	class ScopedSpan
+	{
+	private:
+		uint plane;
+		Span span;
+		chrono::steady_clock::time_point start;
+
+	public:
+		ScopedSpan(uint _plane, Span _span) : plane(_plane), span(_span)
+		{
+			if (enabled)
+				start = chrono::steady_clock::now();
+		}
+
+		~ScopedSpan()
+		{
+			if (enabled)
+				addTime(plane, span, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+		}
+	};
+};
+
+#ifdef ENABLE_METRICS
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_SPAN(plane, span) Metrics::ScopedSpan METRICS_CONCAT(metricsSpan, __LINE__)(plane, span)
+#define METRICS_COUNT(plane, counter, amount) do { if (Metrics::isEnabled()) Metrics::count(plane, counter, amount); } while (false)
+#else
+#define METRICS_SPAN(plane, span) do {} while (false)
+#define METRICS_COUNT(plane, counter, amount) do {} while (false)
+#endif
@@ -0,0 +1,147 @@
+#include "Options.h"
+
+#include "CompressionEngine.h"
+
+void Options::printUsage(ostream& out)
+{
+    out <<
+        "usage: BlockCompression [options] < input\n"
+        "  --planes N    number of block planes moving through the read/compress/write stages (default 3)\n"
+        "  --stats       print timings to stderr when finished\n"
+        "  --binary      write compressed blocks in the binary format\n"
+        "  --decode      convert binary output on stdin back to text\n"
+        "  --to-binary   convert the input to the binary voxel format instead of compressing it\n"
+        "  --update FILE read changed voxels and write FILE, a previous text output, with their parent blocks recompressed\n"
+        "  --engine NAME compression engine, one of " << CompressionEngine::getNames() << " (default greedy)\n"
+        "                maxbox takes 10-25 times as long as greedy and never writes more blocks\n"
+        "  --cache MB    reuse the blocks of repeated parent blocks, keeping up to MB megabytes of them (default 0, off)\n"
+        "  --metrics FILE write the time spent in each stage and what it produced, per plane and in total, to FILE as JSON\n"
+        "  --wide-tags   allow more than 256 tags in text input, binary input says how many it has so never needs it\n"
+        "  --memory-budget MB process each plane in strips of parent block rows that fit in about MB megabytes, spilling\n"
+        "                the rest of the plane to a temporary file, instead of holding whole planes in the --planes ring\n"
+        "  --help        show this message\n";
+}
+
+// parse command line options, exits on anything unrecognised
+Options Options::parse(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+
+        if (arg == "--planes" && i + 1 < argc)
+        {
+            int numPlanes = atoi(argv[++i]);
+            if (numPlanes < 1)
+            {
+                cerr << "--planes must be at least 1\n";
+                exit(1);
+            }
+
+            options.numPlanes = numPlanes;
+        }
+        else if (arg == "--stats")
+        {
+            options.printStats = true;
+        }
+        else if (arg == "--binary")
+        {
+            options.outputFormat = OutputFormat::binary;
+        }
+        else if (arg == "--decode")
+        {
+            options.decode = true;
+        }
+        else if (arg == "--to-binary")
+        {
+            options.toBinary = true;
+        }
+        else if (arg == "--update" && i + 1 < argc)
+        {
+            options.updatePath = argv[++i];
+        }
+        else if (arg == "--engine" && i + 1 < argc)
+        {
+            options.engine = argv[++i];
+            if (CompressionEngine::create(options.engine) == nullptr)
+            {
+                cerr << "unknown engine " << options.engine << ", expected one of " << CompressionEngine::getNames() << "\n";
+                exit(1);
+            }
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            int cacheMegabytes = atoi(argv[++i]);
+            if (cacheMegabytes < 0)
+            {
+                cerr << "--cache must not be negative\n";
+                exit(1);
+            }
+
+            options.cacheMegabytes = cacheMegabytes;
+        }
+        else if (arg == "--metrics" && i + 1 < argc)
+        {
+#ifdef ENABLE_METRICS
+            options.metricsPath = argv[++i];
+#else
+            cerr << "--metrics needs a build with ENABLE_METRICS defined\n";
+            exit(1);
+#endif
+        }
+        else if (arg == "--wide-tags")
+        {
+            options.wideTags = true;
+        }
+        else if (arg == "--memory-budget" && i + 1 < argc)
+        {
+            int memoryBudgetMegabytes = atoi(argv[++i]);
+            if (memoryBudgetMegabytes < 1)
+            {
+                cerr << "--memory-budget must be at least 1\n";
+                exit(1);
+            }
+
+            options.memoryBudgetMegabytes = memoryBudgetMegabytes;
+        }
+        else if (arg == "--help")
+        {
+            printUsage(cout);
+            exit(0);
+        }
+        else
+        {
+            cerr << "unknown option " << arg << "\n";
+            printUsage(cerr);
+            exit(1);
+        }
+    }
+
+    if (!options.metricsPath.empty() && !options.updatePath.empty())
+    {
+        cerr << "--metrics only works for a full run, not --update\n";
+        exit(1);
+    }
+
+    if (!options.updatePath.empty() && options.outputFormat == OutputFormat::binary)
+    {
+        cerr << "--update only works with text output\n";
+        exit(1);
+    }
+
+    if (options.memoryBudgetMegabytes != 0 && !options.updatePath.empty())
+    {
+        cerr << "--memory-budget only works for a full run, not --update\n";
+        exit(1);
+    }
+
+    if (options.wideTags && (options.outputFormat == OutputFormat::binary || !options.updatePath.empty()))
+    {
+        cerr << "--wide-tags only works for text output, not --binary or --update\n";
+        exit(1);
+    }
+
+    return options;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include "BlockWriter.h"
+#include "uDataTypes.h"
+
+using namespace std;
+
+// settings chosen on the command line
+struct Options
+{
+	uint numPlanes = 3;				// BlockPlanes in the read/compress/write ring
+	bool printStats = false;		// report timings to stderr when finished
+	OutputFormat outputFormat = OutputFormat::text;
+	bool decode = false;			// convert binary output from stdin back to text instead of compressing
+	bool toBinary = false;			// convert text input to the binary voxel format instead of compressing
+	string updatePath;				// old output to update with changed voxels from stdin, empty for a full run
+	string engine = "greedy";		// name of the CompressionEngine merging lines into blocks
+	uint cacheMegabytes = 0;		// memory budget of the BlockCache, 0 to compress every parent block
+	string metricsPath;				// where to write per plane times and counts as JSON, empty for none
+	bool wideTags = false;			// read with 16 bit tag IDs, only needed for text input with more than 256 tags
+	uint memoryBudgetMegabytes = 0;	// process planes in strips that fit in this many megabytes, 0 for whole planes in the ring
+
+	static Options parse(int argc, char* argv[]);
+	static void printUsage(ostream& out);
+};
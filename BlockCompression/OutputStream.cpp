@@ -0,0 +1,55 @@
+#include "OutputStream.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+vector<char> OutputStream::buffer(OUTPUT_BUFFER_SIZE);
+size_t OutputStream::used = 0;
+
+// write everything collected so far
+void OutputStream::flush()
+{
+    if (used != 0 && fwrite(buffer.data(), sizeof(char), used, stdout) != used)
+    {
+        cerr << "Failed to write output\n";
+        exit(2);
+    }
+
+    used = 0;
+    fflush(stdout);
+}
+
+void OutputStream::write(const char* data, size_t size)
+{
+    // make room, anything bigger than the whole buffer skips it
+    if (used + size > buffer.size())
+    {
+        flush();
+
+        if (size > buffer.size())
+        {
+            if (fwrite(data, sizeof(char), size, stdout) != size)
+            {
+                cerr << "Failed to write output\n";
+                exit(2);
+            }
+
+            return;
+        }
+    }
+
+    memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void OutputStream::setBinaryMode()
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// how many chars are collected before writing to stdout
+#define OUTPUT_BUFFER_SIZE 8388608
+
+using namespace std;
+
+// collects output into a large buffer so stdout is written with few, large calls
+class OutputStream
+{
+private:
+	static vector<char> buffer;
+	static size_t used;
+
+public:
+	static void write(const char* data, size_t size);
+	static void flush();
+	static void setBinaryMode();			// stop newlines being translated on platforms that do
+};
@@ -0,0 +1,285 @@
+#include "OutputUpdater.h"
+
+#include <algorithm>
+#include <cstdio>
+#include "LineParsing.h"
+#include "OutputStream.h"
+#include "TagReader.h"
+#include "ThreadPool.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+vec3<ushort> OutputUpdater::volumeDim = { 1, 1, 1 };
+vec3<ushort> OutputUpdater::pBlockDim = { 1, 1, 1 };
+vec3<ushort> OutputUpdater::numPBlocks = { 1, 1, 1 };
+TagTable* OutputUpdater::tagTable = nullptr;
+
+// map a whole file into memory, or read it into 'contents' where mapping is not possible
+static void loadFile(const string& path, vector<char>& contents, const char*& begin, const char*& end)
+{
+#ifndef _WIN32
+    int file = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (file >= 0 && fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+
+        if (mapping != MAP_FAILED)
+        {
+            begin = (const char*)mapping;
+            end = begin + info.st_size;
+            return;
+        }
+    }
+    else if (file >= 0)
+    {
+        close(file);
+    }
+#endif
+
+    FILE* stream = fopen(path.c_str(), "rb");
+    if (stream == nullptr)
+    {
+        cerr << "Could not open " << path << "\n";
+        exit(2);
+    }
+
+    char chunk[65536];
+    size_t numRead;
+    while ((numRead = fread(chunk, sizeof(char), sizeof(chunk), stream)) != 0)
+        contents.insert(contents.end(), chunk, chunk + numRead);
+    fclose(stream);
+
+    begin = contents.data();
+    end = begin + contents.size();
+}
+
+// parent blocks are numbered in the order they are written, x fastest then y then z
+inline unsigned long long OutputUpdater::getPBlockKey(vec3<ushort> position)
+{
+    return position.x / pBlockDim.x
+        + (unsigned long long)(position.y / pBlockDim.y) * numPBlocks.x
+        + (unsigned long long)(position.z / pBlockDim.z) * numPBlocks.x * numPBlocks.y;
+}
+
+inline vec3<ushort> OutputUpdater::getPBlockOrigin(unsigned long long key)
+{
+    return
+    {
+        (ushort)(key % numPBlocks.x * pBlockDim.x),
+        (ushort)(key / numPBlocks.x % numPBlocks.y * pBlockDim.y),
+        (ushort)(key / numPBlocks.x / numPBlocks.y * pBlockDim.z)
+    };
+}
+
+// parent block of the block written on a line
+// lines that do not describe a block are treated as being after every parent block
+unsigned long long OutputUpdater::linePBlockKey(const char* line, const char* end)
+{
+    unsigned long long x, y, z;
+    if (!parseCoordinate(line, end, x) || !parseCoordinate(line, end, y) || !parseCoordinate(line, end, z))
+        return ~0ull;
+
+    if (x >= volumeDim.x || y >= volumeDim.y || z >= volumeDim.z)
+        return ~0ull;
+
+    return getPBlockKey({ (ushort)x, (ushort)y, (ushort)z });
+}
+
+// binary search for the first line in [begin, end) of a parent block at or after 'key'
+// 'begin' must be the start of a line
+const char* OutputUpdater::findPBlockStart(const char* begin, const char* end, unsigned long long key)
+{
+    if (begin == end || linePBlockKey(begin, end) >= key)
+        return begin;
+
+    // low is always before the answer, high is always at or after it
+    const char* low = begin;
+    const char* high = end;
+    while (true)
+    {
+        const char* line = nextLineStart(low + (high - low) / 2, high);
+
+        // no line starts in the upper half, try the first line after low
+        if (line == high)
+        {
+            line = nextLineStart(low, high);
+            if (line == high)
+                return high;
+        }
+
+        if (linePBlockKey(line, high) < key)
+            low = line;
+        else
+            high = line;
+    }
+}
+
+// read every changed voxel from stdin, sorted by parent block with later changes to a voxel after earlier ones
+void OutputUpdater::readChanges(vector<VoxelChange>& changes)
+{
+    vec3<ushort> position;
+    string_view tag;
+    while (TagReader::getNextVoxel(position, tag))
+    {
+        if (position.x >= volumeDim.x || position.y >= volumeDim.y || position.z >= volumeDim.z)
+        {
+            cerr << "Voxel " << position.x << "," << position.y << "," << position.z << " is outside the volume\n";
+            exit(2);
+        }
+
+        vec3<ushort> local =
+        {
+            (ushort)(position.x % pBlockDim.x),
+            (ushort)(position.y % pBlockDim.y),
+            (ushort)(position.z % pBlockDim.z)
+        };
+
+        changes.push_back(
+        {
+            getPBlockKey(position),
+            local.x + local.y * (uint)pBlockDim.x + local.z * (uint)pBlockDim.x * pBlockDim.y,
+            tagTable->getID(tag)
+        });
+    }
+
+    stable_sort(changes.begin(), changes.end(), [](const VoxelChange& a, const VoxelChange& b)
+    {
+        return a.pBlockKey < b.pBlockKey;
+    });
+}
+
+// fill a parent block's grid of IDs from the blocks the old output describes it with
+void OutputUpdater::readOldBlocks(const char* begin, const char* end, UpdatedParentBlock& updated)
+{
+    vec3<ushort> origin = updated.parentBlock.getOrigin().cast<ushort>();
+    updated.ids.resize(pBlockDim.volume());
+
+    unsigned long long numCovered = 0;
+    for (const char* line = begin; line != end; line = nextLineStart(line, end))
+    {
+        const char* lineEnd = nextLineStart(line, end);
+
+        unsigned long long numbers[6];
+        const char* c = line;
+        for (unsigned long long& number : numbers)
+        {
+            if (!parseCoordinate(c, lineEnd, number))
+            {
+                cerr << "Old output has a line that is not a block\n";
+                exit(2);
+            }
+        }
+
+        const char* open = (const char*)memchr(c, '\'', lineEnd - c);
+        const char* close = open == nullptr ? nullptr : (const char*)memchr(open + 1, '\'', lineEnd - open - 1);
+        if (close == nullptr)
+        {
+            cerr << "Old output has a block without a tag\n";
+            exit(2);
+        }
+        uchar ID = tagTable->getID(string_view(open + 1, close - open - 1));
+
+        // position relative to the parent block, which the line is already known to start in
+        vec3<ushort> blockOrigin = { (ushort)(numbers[0] - origin.x), (ushort)(numbers[1] - origin.y), (ushort)(numbers[2] - origin.z) };
+        vec3<ushort> blockSize = { (ushort)numbers[3], (ushort)numbers[4], (ushort)numbers[5] };
+        if (blockOrigin.x + numbers[3] > pBlockDim.x || blockOrigin.y + numbers[4] > pBlockDim.y || blockOrigin.z + numbers[5] > pBlockDim.z)
+        {
+            cerr << "Old output has a block crossing a parent block boundary\n";
+            exit(2);
+        }
+
+        for (ushort z = 0; z < blockSize.z; z++)
+        {
+            for (ushort y = 0; y < blockSize.y; y++)
+            {
+                uchar* row = updated.ids.data() + blockOrigin.x + (blockOrigin.y + y) * (size_t)pBlockDim.x + (blockOrigin.z + z) * (size_t)pBlockDim.x * pBlockDim.y;
+                memset(row, ID, blockSize.x);
+            }
+        }
+
+        numCovered += blockSize.volume();
+    }
+
+    // blocks never overlap so anything less means part of the parent block is missing
+    if (numCovered != pBlockDim.volume())
+    {
+        cerr << "Old output does not cover the parent block at " << origin.x << "," << origin.y << "," << origin.z << "\n";
+        exit(2);
+    }
+}
+
+// read changed voxels from stdin and write the old output with their parent blocks compressed again
+void OutputUpdater::run(const string& oldOutputPath, vec3<ushort> _volumeDim, vec3<ushort> _pBlockDim, TagTable& _tagTable)
+{
+    volumeDim = _volumeDim;
+    pBlockDim = _pBlockDim;
+    numPBlocks = { (ushort)(volumeDim.x / pBlockDim.x), (ushort)(volumeDim.y / pBlockDim.y), (ushort)(volumeDim.z / pBlockDim.z) };
+    tagTable = &_tagTable;
+
+    ParentBlock::setup(pBlockDim, tagTable, OutputFormat::text);
+
+    vector<VoxelChange> changes;
+    readChanges(changes);
+
+    vector<char> contents;
+    const char* oldBegin;
+    const char* oldEnd;
+    loadFile(oldOutputPath, contents, oldBegin, oldEnd);
+
+    // a few parent blocks per thread are rebuilt and compressed at once
+    ThreadPool& pool = ThreadPool::shared();
+    const size_t batchSize = (size_t)pool.getNumThreads() * 4;
+    vector<UpdatedParentBlock> batch;
+
+    const char* unchanged = oldBegin;
+    size_t change = 0;
+    while (change < changes.size())
+    {
+        batch.clear();
+
+        // tags are added to the shared table so old blocks are read on this thread
+        while (change < changes.size() && batch.size() < batchSize)
+        {
+            const unsigned long long key = changes[change].pBlockKey;
+
+            const char* pBlockBegin = findPBlockStart(unchanged, oldEnd, key);
+            const char* pBlockEnd = findPBlockStart(pBlockBegin, oldEnd, key + 1);
+
+            batch.emplace_back(getPBlockOrigin(key));
+            UpdatedParentBlock& updated = batch.back();
+            updated.unchangedBegin = unchanged;
+            updated.unchangedEnd = pBlockBegin;
+            readOldBlocks(pBlockBegin, pBlockEnd, updated);
+
+            for (; change < changes.size() && changes[change].pBlockKey == key; change++)
+                updated.ids[changes[change].localIndex] = changes[change].ID;
+
+            unchanged = pBlockEnd;
+        }
+
+        pool.parallelFor(batch.size(), [&batch](size_t i)
+        {
+            UpdatedParentBlock& updated = batch[i];
+            updated.parentBlock.storeVoxels(updated.ids.data(), pBlockDim.x, (size_t)pBlockDim.x * pBlockDim.y);
+            updated.parentBlock.compressPrint();
+        });
+
+        for (const UpdatedParentBlock& updated : batch)
+        {
+            OutputStream::write(updated.unchangedBegin, updated.unchangedEnd - updated.unchangedBegin);
+
+            const BlockWriter& output = updated.parentBlock.getOutput();
+            OutputStream::write(output.data(), output.size());
+        }
+    }
+
+    OutputStream::write(unchanged, oldEnd - unchanged);
+    OutputStream::flush();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ParentBlock.h"
+#include "TagTable.h"
+#include "vec3.h"
+#include "uDataTypes.h"
+
+using namespace std;
+
+// a voxel whose tag has changed since the old output was made
+struct VoxelChange
+{
+	unsigned long long pBlockKey;		// which parent block the voxel is in
+	uint localIndex;					// row-major index of the voxel inside its parent block
+	uchar ID;
+};
+
+// a parent block touched by changes, rebuilt from the old output and compressed again
+struct UpdatedParentBlock
+{
+	const char* unchangedBegin;			// old output between the previous updated parent block and this one
+	const char* unchangedEnd;
+	vector<uchar> ids;					// tag ID of every voxel in the parent block
+	ParentBlock parentBlock;
+
+	UpdatedParentBlock(vec3<ushort> origin) : unchangedBegin(nullptr), unchangedEnd(nullptr), parentBlock(origin.cast<uint>()) {}
+};
+
+// rewrites text output so only the parent blocks containing changed voxels are compressed again
+// parent blocks are written one after another in order, so each one's lines are found by binary search
+// and everything in between is copied across without being parsed
+class OutputUpdater
+{
+private:
+	static vec3<ushort> volumeDim;
+	static vec3<ushort> pBlockDim;
+	static vec3<ushort> numPBlocks;
+	static TagTable* tagTable;
+
+	static unsigned long long getPBlockKey(vec3<ushort> position);
+	static vec3<ushort> getPBlockOrigin(unsigned long long key);
+	static unsigned long long linePBlockKey(const char* line, const char* end);
+	static const char* findPBlockStart(const char* begin, const char* end, unsigned long long key);
+	static void readChanges(vector<VoxelChange>& changes);
+	static void readOldBlocks(const char* begin, const char* end, UpdatedParentBlock& updated);
+
+public:
+	static void run(const string& oldOutputPath, vec3<ushort> volumeDim, vec3<ushort> pBlockDim, TagTable& tagTable);
+};
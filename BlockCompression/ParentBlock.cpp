@@ -1,44 +1,124 @@
 #include "ParentBlock.h"
 
-vec3<ushort> ParentBlock::pBlockDim = { 1, 1, 1 };
-vec3<unsigned long> ParentBlock::translations = { 1, 1, 1 };
-TagTable* ParentBlock::tt = nullptr;
+#include <algorithm>
+#include <cstring>
+#include "RunFinder.h"
 
-// static method for setup of ParentBlock class
-// store information that will be constant for every parent block
-// must be called before creating a ParentBlock instance
-void ParentBlock::setup(vec3<ushort> dimensions, TagTable* planeTagTable)
+ParentBlock::Settings ParentBlock::sharedSettings;
+
+// information that will be constant for every parent block of a model
+// 'specialise' allows kernels built for a fixed parent block shape to be used
+ParentBlock::Settings::Settings(vec3<ushort> dimensions, const TagNames* tagNames, OutputFormat format, bool specialise)
 {
     // dimension of parent block
     pBlockDim = dimensions;
 
-    // number of 1D voxels needed to move for each dimension of 3D movement
-    translations = { 1, dimensions.x, (ulong)(dimensions.x * dimensions.y) };
+    // tag names used for printing
+    tt = tagNames;
+
+    // rows are split into lines with the widest instruction set available
+    RunFinder::setup();
+
+    // how compressed blocks are printed
+    outputFormat = format;
+
+    // only shapes whose fixed layout measurably beats the runtime one in CompressBenchmark are specialised
+    // 16^3, 32^3 and 64^3 were within noise of it, so use the runtime layout like any other shape
+    const bool isCube = dimensions.x == dimensions.y && dimensions.y == dimensions.z;
+    if (specialise && isCube && dimensions.x == 8)
+        selectKernels<CubeLayout<8>>(*this, "8x8x8");
+    else if (pBlockDim.volume() < IndexVolume<ushort>::nullIndex)
+        selectKernels<RuntimeLayout<ushort>>(*this, "runtime 16 bit");
+    else
+        selectKernels<RuntimeLayout<uint>>(*this, "runtime 32 bit");
+}
+
+// static method for setup of the settings shared by parent blocks created without their own
+// must be called before creating a ParentBlock instance that uses them
+void ParentBlock::setup(vec3<ushort> dimensions, const TagNames* planeTagNames, OutputFormat format, bool specialise)
+{
+    // the engine may have been chosen first
+    const CompressionEngine* engine = sharedSettings.engine;
+    sharedSettings = Settings(dimensions, planeTagNames, format, specialise);
+    sharedSettings.engine = engine;
+
+    if (BlockCache::shared().isEnabled())
+        sharedSettings.cache = &BlockCache::shared();
+}
+
+// use the kernels built for a layout from now on
+template <typename Layout>
+void ParentBlock::selectKernels(Settings& settings, const char* name)
+{
+    settings.kernelName = name;
+    settings.compressKernel = &ParentBlock::compress<Layout>;
+    settings.storeKernel = &ParentBlock::storeLines<Layout>;
+
+    // index volumes are allocated to match
+    settings.useNarrowIndices = is_same_v<typename Layout::Index, ushort>;
+}
+
+// engine used by compressPrint, shared by every parent block using the shared settings
+void ParentBlock::setEngine(const CompressionEngine* compressionEngine)
+{
+    sharedSettings.engine = compressionEngine;
+}
+
+const CompressionEngine* ParentBlock::getEngine()
+{
+    return sharedSettings.engine;
+}
+
+const char* ParentBlock::getKernelName()
+{
+    return sharedSettings.kernelName;
+}
+
+vec3<ushort> ParentBlock::getDimensions() const
+{
+    return settings->pBlockDim;
+}
 
-    // tag table used for lookups
-    tt = planeTagTable;
+// the index volume this parent block was created with
+template <typename Index>
+inline IndexVolume<Index>& ParentBlock::getIndexVolume()
+{
+    if constexpr (is_same_v<Index, ushort>)
+        return narrowIndices;
+    else
+        return wideIndices;
 }
 
-// use pre-calculated translations to find 1D position from 3D
+// use the layout's strides to find 1D position from 3D
+template <typename Layout>
 inline uint ParentBlock::convert3DIndexTo1D(const vec3<ushort>& position) 
 {
-    return position.x + position.y * translations.y + position.z * translations.z;
+    return (uint)(position.x + position.y * Layout::strideY + position.z * Layout::strideZ);
 }
 
 // update the index volume for all active blocks
+template <typename Layout>
 inline void ParentBlock::refreshBlockIndices()
 {
-    for (const Block& block : blocks)
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
+    blocks.forEachValid([this, &blockIndices](uint block)
     {
-        if (block.isValid)
-            fillSubVolume(blockIndices[block.index], block.subVolume);
-    }
+        fillSubVolume<Layout>(blockIndices[blocks.indices[block]], blocks.subVolumes[block]);
+    });
+}
+
+ParentBlock::ParentBlock(vec3<uint> _originWS) : ParentBlock(_originWS, sharedSettings)
+{
 }
 
-ParentBlock::ParentBlock(vec3<ushort> _originWS)
+ParentBlock::ParentBlock(vec3<uint> _originWS, const Settings& _settings) : settings(&_settings)
 {
     // create a 1D array to hold the contents of a 3D volume
-	blockIndices.resize(pBlockDim.volume());
+    if (settings->useNarrowIndices)
+        narrowIndices.indices.resize(settings->pBlockDim.volume());
+    else
+        wideIndices.indices.resize(settings->pBlockDim.volume());
 
     // set parent block's voxel offset from total volume origin
     originWS = _originWS;
@@ -46,10 +126,13 @@ ParentBlock::ParentBlock(vec3<ushort> _originWS)
     currentIndex = 0;
 }
 
-inline void ParentBlock::fillSubVolume(uint newValue, const SubVolume& subVolume)
+template <typename Layout>
+inline void ParentBlock::fillSubVolume(typename Layout::Index newValue, const SubVolume& subVolume)
 {
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
     // 1D position of sub-volume origin within parent-block
-    unsigned long startIndex = convert3DIndexTo1D(subVolume.origin);
+    unsigned long startIndex = convert3DIndexTo1D<Layout>(subVolume.origin);
 
     for (int z = 0; z < subVolume.size.z; z++)
     {
@@ -66,78 +149,93 @@ inline void ParentBlock::fillSubVolume(uint newValue, const SubVolume& subVolume
 
             // reset X
             // move up Y once
-            lookupIndex += translations.y;
+            lookupIndex += Layout::strideY;
         }
 
         // reset X and Y
         // move up Z once
-        startIndex += translations.z;
+        startIndex += Layout::strideZ;
     }
 }
 
 // expand a Block along Y to cover a SubVolume
 // assumes the origin/size is exact same for X & Z
-inline void ParentBlock::mergeUpY(Block& block, const SubVolume& subVolume)
+template <typename Layout>
+inline void ParentBlock::mergeUpY(uint block, const SubVolume& subVolume)
 {
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
+    SubVolume& blockVolume = blocks.subVolumes[block];
+
     // top-most index of block
-    ushort top1 = block.subVolume.origin.y + block.subVolume.size.y;
+    ushort top1 = blockVolume.origin.y + blockVolume.size.y;
     // top-most index of subVolume
     ushort top2 = subVolume.origin.y + subVolume.size.y;
     ushort deltaLength = top2 - top1;
 
     // the volume the block will expand to cover
-    SubVolume difference = block.subVolume;
-    difference.origin.y += block.subVolume.size.y;
+    SubVolume difference = blockVolume;
+    difference.origin.y += blockVolume.size.y;
     difference.size.y = deltaLength;
 
     // update all the blockIndices in the difference to the new block
-    fillSubVolume(blockIndices[block.index], difference);
+    fillSubVolume<Layout>(blockIndices[blocks.indices[block]], difference);
 
     // grow block below to stretch to the top of the input volume
-    block.subVolume.size.y += deltaLength;
+    blockVolume.size.y += deltaLength;
 }
 
 // expand a Block along Z to cover a SubVolume
 // assumes the origin/size is exact same for X & Y
-inline void ParentBlock::mergeUpZ(Block& block, const SubVolume& subVolume)
+template <typename Layout>
+inline void ParentBlock::mergeUpZ(uint block, const SubVolume& subVolume)
 {
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
+    SubVolume& blockVolume = blocks.subVolumes[block];
+
     // top-most index of block
-    ushort top1 = block.subVolume.origin.z + block.subVolume.size.z;
+    ushort top1 = blockVolume.origin.z + blockVolume.size.z;
     // top-most index of subVolume
     ushort top2 = subVolume.origin.z + subVolume.size.z;
 	ushort deltaLength = top2 - top1;
 
     // the volume the block will expand to cover
-    SubVolume difference = block.subVolume;
-    difference.origin.z += block.subVolume.size.z;
+    SubVolume difference = blockVolume;
+    difference.origin.z += blockVolume.size.z;
     difference.size.z = deltaLength;
 
     // update all the blockIndices in the difference to the new block
-    fillSubVolume(blockIndices[block.index], difference);
+    fillSubVolume<Layout>(blockIndices[blocks.indices[block]], difference);
 
     // grow block below to stretch to the top of the input volume
-    block.subVolume.size.z += deltaLength;
+    blockVolume.size.z += deltaLength;
 
     
 }
 
+template <typename Layout>
 inline bool ParentBlock::shelfCompressY(const SubVolume& subVolume, uint index, uchar topID)
 {
-    const uint blockBelowIndex = blockIndices[index];
-    Block& blockBelow = blocks[blockBelowIndex];
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
+    const typename Layout::Index blockBelowIndex = blockIndices[index];
 
-	if (blockBelow.ID != topID)
+    if (blocks.IDs[blockBelowIndex] != topID)
         return false;
 
+    SubVolume& below = blocks.subVolumes[blockBelowIndex];
+    uint& belowIndex = blocks.indices[blockBelowIndex];
+
     const ushort xMin1 = subVolume.origin.x;
-    const ushort xMin2 = blockBelow.subVolume.origin.x;
+    const ushort xMin2 = below.origin.x;
     const ushort xMax1 = subVolume.origin.x + subVolume.size.x;
-    const ushort xMax2 = blockBelow.subVolume.origin.x + blockBelow.subVolume.size.x;
+    const ushort xMax2 = below.origin.x + below.size.x;
 
     const ushort zMin1 = subVolume.origin.z;
-    const ushort zMin2 = blockBelow.subVolume.origin.z;
+    const ushort zMin2 = below.origin.z;
     const ushort zMax1 = subVolume.origin.z + subVolume.size.z;
-    const ushort zMax2 = blockBelow.subVolume.origin.z + blockBelow.subVolume.size.z;
+    const ushort zMax2 = below.origin.z + below.size.z;
 
     const bool alignedXMin = xMin1 == xMin2;
     const bool alignedXMax = xMax1 == xMax2;
@@ -149,43 +247,43 @@ inline bool ParentBlock::shelfCompressY(const SubVolume& subVolume, uint index,
     // perfect match, can merge
     if (alignedEdges == 4)
     {
-        mergeUpY(blockBelow, subVolume);
+        mergeUpY<Layout>(blockBelowIndex, subVolume);
         return true;
     }
 
     // have too many shelves or nothing below, cannot merge
-    if (alignedEdges < 3 || blockBelow.subVolume.origin.y == 0)
+    if (alignedEdges < 3 || below.origin.y == 0)
         return false;
 
-    uint nextBlockIndex = index - blockBelow.subVolume.size.y * translations.y;
+    uint nextBlockIndex = index - below.size.y * Layout::strideY;
 
     // single shelf along X, negative direction
     if (xMin1 > xMin2)
     {
         // try to continue merging along Y
-        if (shelfCompressY(subVolume, nextBlockIndex, topID))
+        if (shelfCompressY<Layout>(subVolume, nextBlockIndex, topID))
         {
             // block below becomes shelf to move out of way
-            blockBelow.subVolume.size.x -= subVolume.size.x;
+            below.size.x -= subVolume.size.x;
             return true;
         }
 
         // this is the shelf's SubVolume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.size.x -= subVolume.size.x;
-        unsigned long virtualIndex = blockBelow.index;
+        unsigned long virtualIndex = belowIndex;
 
         // try to remove shelf
-        if (shelfCompressY(virtualVolume, virtualIndex - translations.y, topID) ||
-            (blockBelow.subVolume.origin.z != 0 && shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID)))
+        if (shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID) ||
+            (below.origin.z != 0 && shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID)))
         {
             // remove shelf from blockBelow
-            blockBelow.subVolume.origin.x = subVolume.origin.x;
-            blockBelow.subVolume.size.x = subVolume.size.x;
-            blockBelow.index += virtualVolume.size.x * translations.x;
+            below.origin.x = subVolume.origin.x;
+            below.size.x = subVolume.size.x;
+            belowIndex += virtualVolume.size.x * Layout::strideX;
 
             // merge blockBelow upto the start
-            mergeUpY(blockBelow, subVolume);
+            mergeUpY<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -194,31 +292,31 @@ inline bool ParentBlock::shelfCompressY(const SubVolume& subVolume, uint index,
     else if (xMax1 < xMax2)
     {
         // try to continue merging along Y
-        if (shelfCompressY(subVolume, nextBlockIndex, topID))
+        if (shelfCompressY<Layout>(subVolume, nextBlockIndex, topID))
         {
             // block below becomes shelf to move out of way
-            blockBelow.subVolume.origin.x += subVolume.size.x;
-            blockBelow.subVolume.size.x -= subVolume.size.x;
-            blockBelow.index += subVolume.size.x * translations.x;
+            below.origin.x += subVolume.size.x;
+            below.size.x -= subVolume.size.x;
+            belowIndex += subVolume.size.x * Layout::strideX;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.origin.x += subVolume.size.x;
         virtualVolume.size.x -= subVolume.size.x;
-        unsigned long virtualIndex = blockBelow.index + subVolume.size.x * translations.x;
+        unsigned long virtualIndex = belowIndex + subVolume.size.x * Layout::strideX;
 
         // try to remove shelf
-        if (shelfCompressY(virtualVolume, virtualIndex - translations.y, topID) || 
-            (blockBelow.subVolume.origin.z != 0 && shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID)))
+        if (shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID) || 
+            (below.origin.z != 0 && shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID)))
         {
             // remove shelf from blockBelow
-            blockBelow.subVolume.origin.x = subVolume.origin.x;
-            blockBelow.subVolume.size.x = subVolume.size.x;
+            below.origin.x = subVolume.origin.x;
+            below.size.x = subVolume.size.x;
 
             // merge blockBelow up to the start
-            mergeUpY(blockBelow, subVolume);
+            mergeUpY<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -227,31 +325,31 @@ inline bool ParentBlock::shelfCompressY(const SubVolume& subVolume, uint index,
     else if (zMax1 < zMax2)
     {
         // try to continue merging along Y
-        if (shelfCompressY(subVolume, nextBlockIndex, topID))
+        if (shelfCompressY<Layout>(subVolume, nextBlockIndex, topID))
         {
             // block below becomes shelf to move out of way
-            blockBelow.subVolume.origin.z += subVolume.size.z;
-            blockBelow.subVolume.size.z -= subVolume.size.z;
-            blockBelow.index += subVolume.size.z * translations.z;
+            below.origin.z += subVolume.size.z;
+            below.size.z -= subVolume.size.z;
+            belowIndex += subVolume.size.z * Layout::strideZ;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.origin.z += subVolume.size.z;
         virtualVolume.size.z -= subVolume.size.z;
-        unsigned long virtualIndex = blockBelow.index + subVolume.size.z * translations.z;
+        unsigned long virtualIndex = belowIndex + subVolume.size.z * Layout::strideZ;
 
         // try to remove shelf
         // don't merge down Z as the original block is in that direction
-        if (shelfCompressY(virtualVolume, virtualIndex - translations.y, topID))
+        if (shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID))
         {
             // remove shelf from blockBelow
-            blockBelow.subVolume.origin.z = subVolume.origin.z;
-            blockBelow.subVolume.size.z = subVolume.size.z;
+            below.origin.z = subVolume.origin.z;
+            below.size.z = subVolume.size.z;
 
             // merge blockBelow up to the start
-            mergeUpY(blockBelow, subVolume);
+            mergeUpY<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -260,29 +358,29 @@ inline bool ParentBlock::shelfCompressY(const SubVolume& subVolume, uint index,
     else if (zMin2 < zMin1)
     {
         // try to continue merging along Y
-        if (shelfCompressY(subVolume, nextBlockIndex, topID))
+        if (shelfCompressY<Layout>(subVolume, nextBlockIndex, topID))
         {
             // block below becomes shelf to move out of way
-            blockBelow.subVolume.size.z -= subVolume.size.z;
+            below.size.z -= subVolume.size.z;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.size.z -= subVolume.size.z;
-        unsigned long virtualIndex = blockBelow.index;
+        unsigned long virtualIndex = belowIndex;
 
         // try to remove shelf
-        if (shelfCompressY(virtualVolume, virtualIndex - translations.y, topID) ||
-            (blockBelow.subVolume.origin.z != 0 && shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID)))
+        if (shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID) ||
+            (below.origin.z != 0 && shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID)))
         {
             // remove shelf from blockBelow
-            blockBelow.subVolume.origin.z = subVolume.origin.z;
-            blockBelow.subVolume.size.z = subVolume.size.z;
-            blockBelow.index += virtualVolume.size.z * translations.z;
+            below.origin.z = subVolume.origin.z;
+            below.size.z = subVolume.size.z;
+            belowIndex += virtualVolume.size.z * Layout::strideZ;
 
             // merge blockBelow up to the start
-            mergeUpY(blockBelow, subVolume);
+            mergeUpY<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -291,23 +389,28 @@ inline bool ParentBlock::shelfCompressY(const SubVolume& subVolume, uint index,
     return false;
 }
 
+template <typename Layout>
 inline bool ParentBlock::shelfCompressZ(const SubVolume& subVolume, uint index, uchar topID)
 {
-    const uint blockBelowIndex = blockIndices[index];
-    Block& blockBelow = blocks[blockBelowIndex];
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
 
-    if (blockBelow.ID != topID)
+    const typename Layout::Index blockBelowIndex = blockIndices[index];
+
+    if (blocks.IDs[blockBelowIndex] != topID)
         return false;
 
+    SubVolume& below = blocks.subVolumes[blockBelowIndex];
+    uint& belowIndex = blocks.indices[blockBelowIndex];
+
     const ushort xMin1 = subVolume.origin.x;
-    const ushort xMin2 = blockBelow.subVolume.origin.x;
+    const ushort xMin2 = below.origin.x;
     const ushort xMax1 = subVolume.origin.x + subVolume.size.x;
-    const ushort xMax2 = blockBelow.subVolume.origin.x + blockBelow.subVolume.size.x;
+    const ushort xMax2 = below.origin.x + below.size.x;
 
     const ushort yMin1 = subVolume.origin.y;
-    const ushort yMin2 = blockBelow.subVolume.origin.y;
+    const ushort yMin2 = below.origin.y;
     const ushort yMax1 = subVolume.origin.y + subVolume.size.y;
-    const ushort yMax2 = blockBelow.subVolume.origin.y + blockBelow.subVolume.size.y;
+    const ushort yMax2 = below.origin.y + below.size.y;
 
     const bool alignedXMin = xMin1 == xMin2;
     const bool alignedXMax = xMax1 == xMax2;
@@ -319,44 +422,44 @@ inline bool ParentBlock::shelfCompressZ(const SubVolume& subVolume, uint index,
     // perfect match, can merge
     if (alignedEdges == 4)
     {
-        mergeUpZ(blockBelow, subVolume);
+        mergeUpZ<Layout>(blockBelowIndex, subVolume);
 
         return true;
     }
 
     // have too many shelves, cannot merge
-    if (alignedEdges < 3 || blockBelow.subVolume.origin.z == 0)
+    if (alignedEdges < 3 || below.origin.z == 0)
         return false;
 
-    uint nextBlockIndex = index - blockBelow.subVolume.size.z * translations.z;
+    uint nextBlockIndex = index - below.size.z * Layout::strideZ;
 
     // single shelf along X, negative direction
     if (xMin2 < xMin1)
     {
         // try to remove above subvolume
-        if (shelfCompressZ(subVolume, nextBlockIndex, topID))
+        if (shelfCompressZ<Layout>(subVolume, nextBlockIndex, topID))
         {
             // move block out of the way to the left
-            blockBelow.subVolume.size.x -= subVolume.size.x;
+            below.size.x -= subVolume.size.x;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.size.x -= subVolume.size.x;
-        unsigned long virtualIndex = blockBelow.index;
+        unsigned long virtualIndex = belowIndex;
 
         // try to remove shelf
-        if ((blockBelow.subVolume.origin.y != 0 && shelfCompressY(virtualVolume, virtualIndex - translations.y, topID)) ||
-            shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID))
+        if ((below.origin.y != 0 && shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID)) ||
+            shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID))
         {
             // resize blockBelow by removing the virtual block
-            blockBelow.subVolume.origin.x = subVolume.origin.x;
-            blockBelow.subVolume.size.x = subVolume.size.x;
-            blockBelow.index += virtualVolume.size.x * translations.x;
+            below.origin.x = subVolume.origin.x;
+            below.size.x = subVolume.size.x;
+            belowIndex += virtualVolume.size.x * Layout::strideX;
 
             // merge upto the start
-            mergeUpZ(blockBelow, subVolume);
+            mergeUpZ<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -365,31 +468,31 @@ inline bool ParentBlock::shelfCompressZ(const SubVolume& subVolume, uint index,
     else if (xMax1 < xMax2)
     {
         // try to remove above subvolume
-        if (shelfCompressZ(subVolume, nextBlockIndex, topID))
+        if (shelfCompressZ<Layout>(subVolume, nextBlockIndex, topID))
         {
             // move block out of the way to the right
-            blockBelow.subVolume.origin.x += subVolume.size.x;
-            blockBelow.subVolume.size.x -= subVolume.size.x;
-            blockBelow.index += subVolume.size.x * translations.x;
+            below.origin.x += subVolume.size.x;
+            below.size.x -= subVolume.size.x;
+            belowIndex += subVolume.size.x * Layout::strideX;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.origin.x += subVolume.size.x;
         virtualVolume.size.x -= subVolume.size.x;
-        unsigned long virtualIndex = blockBelow.index + subVolume.size.x * translations.x;
+        unsigned long virtualIndex = belowIndex + subVolume.size.x * Layout::strideX;
 
         // try to remove shelf
-        if ((blockBelow.subVolume.origin.y != 0 && shelfCompressY(virtualVolume, virtualIndex - translations.y, topID)) ||
-            shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID))
+        if ((below.origin.y != 0 && shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID)) ||
+            shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID))
         {
             // resize blockBelow by removing the virtual block
-            blockBelow.subVolume.origin.x = subVolume.origin.x;
-            blockBelow.subVolume.size.x = subVolume.size.x;
+            below.origin.x = subVolume.origin.x;
+            below.size.x = subVolume.size.x;
 
             // merge upto the start
-            mergeUpZ(blockBelow, subVolume);
+            mergeUpZ<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -398,31 +501,31 @@ inline bool ParentBlock::shelfCompressZ(const SubVolume& subVolume, uint index,
     else if (yMax1 < yMax2)
     {
         // try to remove above subvolume
-        if (shelfCompressZ(subVolume, nextBlockIndex, topID))
+        if (shelfCompressZ<Layout>(subVolume, nextBlockIndex, topID))
         {
             // move block out of the way up
-            blockBelow.subVolume.origin.y += subVolume.size.y;
-            blockBelow.subVolume.size.y -= subVolume.size.y;
-            blockBelow.index += subVolume.size.y * translations.y;
+            below.origin.y += subVolume.size.y;
+            below.size.y -= subVolume.size.y;
+            belowIndex += subVolume.size.y * Layout::strideY;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.origin.y += subVolume.size.y;
         virtualVolume.size.y -= subVolume.size.y;
-        unsigned long virtualIndex = blockBelow.index + subVolume.size.y * translations.y;
+        unsigned long virtualIndex = belowIndex + subVolume.size.y * Layout::strideY;
 
         // try to remove shelf
         // cant merge down Y as that would hit the original block
-        if (shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID))
+        if (shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID))
         {
             // resize blockBelow by removing the virtual block
-            blockBelow.subVolume.origin.y = subVolume.origin.y;
-            blockBelow.subVolume.size.y = subVolume.size.y;
+            below.origin.y = subVolume.origin.y;
+            below.size.y = subVolume.size.y;
 
             // merge upto the start
-            mergeUpZ(blockBelow, subVolume);
+            mergeUpZ<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -431,29 +534,29 @@ inline bool ParentBlock::shelfCompressZ(const SubVolume& subVolume, uint index,
     else if (yMin2 < yMin1)
     {
         // try to remove above subvolume
-        if (shelfCompressZ(subVolume, nextBlockIndex, topID))
+        if (shelfCompressZ<Layout>(subVolume, nextBlockIndex, topID))
         {
             // move block out of the way down
-            blockBelow.subVolume.size.y -= subVolume.size.y;
+            below.size.y -= subVolume.size.y;
             return true;
         }
 
         // this is the shelf's volume
-        SubVolume virtualVolume = blockBelow.subVolume;
+        SubVolume virtualVolume = below;
         virtualVolume.size.y -= subVolume.size.y;
-        unsigned long virtualIndex = blockBelow.index;
+        unsigned long virtualIndex = belowIndex;
 
         // try to remove shelf
-        if ((blockBelow.subVolume.origin.y != 0 && shelfCompressY(virtualVolume, virtualIndex - translations.y, topID)) ||
-            shelfCompressZ(virtualVolume, virtualIndex - translations.z, topID))
+        if ((below.origin.y != 0 && shelfCompressY<Layout>(virtualVolume, virtualIndex - Layout::strideY, topID)) ||
+            shelfCompressZ<Layout>(virtualVolume, virtualIndex - Layout::strideZ, topID))
         {
             // resize blockBelow by removing the virtual block
-            blockBelow.subVolume.origin.y = subVolume.origin.y;
-            blockBelow.subVolume.size.y = subVolume.size.y;
-            blockBelow.index += virtualVolume.size.y * translations.y;
+            below.origin.y = subVolume.origin.y;
+            below.size.y = subVolume.size.y;
+            belowIndex += virtualVolume.size.y * Layout::strideY;
 
             // merge upto the start
-            mergeUpZ(blockBelow, subVolume);
+            mergeUpZ<Layout>(blockBelowIndex, subVolume);
 
             return true;
         }
@@ -462,220 +565,481 @@ inline bool ParentBlock::shelfCompressZ(const SubVolume& subVolume, uint index,
     return false;
 }
 
+template <typename Layout>
 inline void ParentBlock::shelfY()
 {
-    for (Block& block : blocks)
+    blocks.forEachValid([this](uint block)
     {
-        if (!block.isValid)
-            continue;
-
         // try and shelf merge down Y
-        if (block.subVolume.origin.y != 0
-            && shelfCompressY(block.subVolume, block.index - translations.y, block.ID))
+        if (blocks.subVolumes[block].origin.y != 0
+            && shelfCompressY<Layout>(blocks.subVolumes[block], blocks.indices[block] - Layout::strideY, blocks.IDs[block]))
         {
-            block.isValid = false;
-            continue;
+            blocks.invalidate(block);
         }
-    }
+    });
 }
 
+template <typename Layout>
 inline void ParentBlock::shelfZ()
 {
-    for (Block& block : blocks)
+    blocks.forEachValid([this](uint block)
     {
-        if (!block.isValid)
-            continue;
-
         // try and shelf merge down Z
-        if (block.subVolume.origin.z != 0
-            && shelfCompressZ(block.subVolume, block.index - translations.z, block.ID))
+        if (blocks.subVolumes[block].origin.z != 0
+            && shelfCompressZ<Layout>(blocks.subVolumes[block], blocks.indices[block] - Layout::strideZ, blocks.IDs[block]))
         {
-            block.isValid = false;
-            continue;
+            blocks.invalidate(block);
         }
-    }
+    });
 }
 
+template <typename Layout>
 inline void ParentBlock::shelfCompress()
 {
-    for (Block& block : blocks)
+    blocks.forEachValid([this](uint block)
     {
-        if (!block.isValid)
-            continue;
+        const SubVolume& subVolume = blocks.subVolumes[block];
 
         // try and shelf merge down Y
-        if (block.subVolume.origin.y != 0 
-            && shelfCompressY(block.subVolume, block.index - translations.y, block.ID))
+        if (subVolume.origin.y != 0 
+            && shelfCompressY<Layout>(subVolume, blocks.indices[block] - Layout::strideY, blocks.IDs[block]))
         {
-            block.isValid = false;
-            continue;
+            blocks.invalidate(block);
+            return;
         }
 
         // try and shelf merge down Z
-        if (block.subVolume.origin.z != 0
-            && shelfCompressZ(block.subVolume, block.index - translations.z, block.ID))
+        if (subVolume.origin.z != 0
+            && shelfCompressZ<Layout>(subVolume, blocks.indices[block] - Layout::strideZ, blocks.IDs[block]))
         {
-            block.isValid = false;
-            continue;
+            blocks.invalidate(block);
+            return;
         }
-    }
+    });
 }
 
+template <typename Layout>
 inline void ParentBlock::greedyCompressY()
 {
-    for (Block& block : blocks)
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
+    blocks.forEachValid([this, &blockIndices](uint block)
     {
-        // cannot merge an invalid block or one at the bottom
-        if (!block.isValid || block.subVolume.origin.y == 0)
-            continue;
+        // cannot merge a block at the bottom
+        if (blocks.subVolumes[block].origin.y == 0)
+            return;
 
         // using the index volume, find the block which is below on Y axis
-        uint blockBelowIndex = blockIndices[block.index - translations.y];
-
-        if (blockBelowIndex == NULL_INDEX)
-            continue;
+        typename Layout::Index blockBelowIndex = blockIndices[blocks.indices[block] - Layout::strideY];
 
-        Block& blockBelow = blocks[blockBelowIndex];
+        if (blockBelowIndex == IndexVolume<typename Layout::Index>::nullIndex)
+            return;
 
-        if (block.ID == blockBelow.ID
-            && block.subVolume.origin.x == blockBelow.subVolume.origin.x
-            && block.subVolume.size.x == blockBelow.subVolume.size.x
+        if (blocks.IDs[block] == blocks.IDs[blockBelowIndex]
+            && blocks.subVolumes[block].origin.x == blocks.subVolumes[blockBelowIndex].origin.x
+            && blocks.subVolumes[block].size.x == blocks.subVolumes[blockBelowIndex].size.x
             // not necessary as Y compression done before Z
-            //&& block.subVolume.origin.z == blockBelow.subVolume.origin.z
-            //&& block.subVolume.size.z == blockBelow.subVolume.size.z
+            //&& blocks.subVolumes[block].origin.z == blocks.subVolumes[blockBelowIndex].origin.z
+            //&& blocks.subVolumes[block].size.z == blocks.subVolumes[blockBelowIndex].size.z
             )
         {
             // disable top block
-            block.isValid = false;
+            blocks.invalidate(block);
 
             // block volume now points to block below
-            blockIndices[block.index] = blockBelowIndex;
+            blockIndices[blocks.indices[block]] = blockBelowIndex;
 
             // grow bottom block to contain top block
             // assume the top block is y size 1
-            blockBelow.subVolume.size.y += 1;
+            blocks.subVolumes[blockBelowIndex].size.y += 1;
         }
-    }
+    });
 }
 
+template <typename Layout>
 inline void ParentBlock::greedyCompressZ()
 {
-    for (Block& block : blocks)
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
+    blocks.forEachValid([this, &blockIndices](uint block)
     {
-        // cannot merge an invalid block or one at the bottom
-        if (!block.isValid || block.subVolume.origin.z == 0)
-            continue;
+        // cannot merge a block at the bottom
+        if (blocks.subVolumes[block].origin.z == 0)
+            return;
 
         // use pointer volume to find next block along Y
-        uint blockBelowIndex = blockIndices[block.index - translations.z];
-
-        if (blockBelowIndex == NULL_INDEX)
-            continue;
+        typename Layout::Index blockBelowIndex = blockIndices[blocks.indices[block] - Layout::strideZ];
 
-        Block& blockBelow = blocks[blockBelowIndex];
+        if (blockBelowIndex == IndexVolume<typename Layout::Index>::nullIndex)
+            return;
 
         // check if they align exactly along X and Y
-        if (block.ID == blockBelow.ID
-            && block.subVolume.origin.x == blockBelow.subVolume.origin.x
-            && block.subVolume.size.x == blockBelow.subVolume.size.x
-            && block.subVolume.origin.y == blockBelow.subVolume.origin.y
-            && block.subVolume.size.y == blockBelow.subVolume.size.y)
+        if (blocks.IDs[block] == blocks.IDs[blockBelowIndex]
+            && blocks.subVolumes[block].origin.x == blocks.subVolumes[blockBelowIndex].origin.x
+            && blocks.subVolumes[block].size.x == blocks.subVolumes[blockBelowIndex].size.x
+            && blocks.subVolumes[block].origin.y == blocks.subVolumes[blockBelowIndex].origin.y
+            && blocks.subVolumes[block].size.y == blocks.subVolumes[blockBelowIndex].size.y)
         {
             // disable top block
-            block.isValid = false;
+            blocks.invalidate(block);
 
             // block volume now points to block below
-            blockIndices[block.index] = blockBelowIndex;
+            blockIndices[blocks.indices[block]] = blockBelowIndex;
 
             // grow bottom block to contain top block
             // assume the top block is z size 1
-            blockBelow.subVolume.size.z += 1;
+            blocks.subVolumes[blockBelowIndex].size.z += 1;
         }
-    }
+    });
 }
 
-// compress and print parent block
+// compress and print parent block into its output buffer
+// parent blocks are independent so may be compressed in parallel
 void ParentBlock::compressPrint()
 {
-    if (allSameTag())
+    compressBlocks();
+    printCompressed();
+}
+
+// merge the stored lines into blocks, or take them from the cache
+void ParentBlock::compressBlocks()
+{
+    if (cachedBlocks)
     {
-        printWholeParentBlock();
+        useCachedBlocks();
         return;
     }
 
+    if (uniform)
+        return;
+
+    settings->engine->compress(*this);
+
+    // uniform parent blocks are found as quickly as a cached one so are not worth keeping
+    // parent blocks with the same voxels in one plane all miss, only the first is kept
+    if (storedIDs != nullptr && !settings->cache->contains(storedHash))
+        cacheBlocks();
+}
+
+// print the compressed blocks into the output buffer
+void ParentBlock::printCompressed()
+{
+    METRICS_SPAN(getPlane(), Span::print);
+
+    if (uniform)
+        printWholeParentBlock();
+    else
+        printBlocks();
+}
+
+void ParentBlock::greedyShelfCompress()
+{
+    (this->*settings->compressKernel)();
+}
+
+// merge lines into as few blocks as possible
+template <typename Layout>
+void ParentBlock::compress()
+{
+    Layout::bind(settings->pBlockDim.x, settings->pBlockDim.y, settings->pBlockDim.z);
+
     // do greedy search to eliminate most blocks quickly
-    greedyCompressY();
-    greedyCompressZ();
-    
+    {
+        METRICS_SPAN(getPlane(), Span::greedy);
+        greedyCompressY<Layout>();
+        greedyCompressZ<Layout>();
+    }
+    METRICS_COUNT(getPlane(), Counter::blocksAfterGreedy, blocks.countValid());
 
     // more complex shelf compression needs index volume to be correct
-    refreshBlockIndices();
-    //shelfCompress();
-    shelfY();
-    shelfZ();
+    {
+        METRICS_SPAN(getPlane(), Span::refreshIndices);
+        refreshBlockIndices<Layout>();
+    }
 
-    // output this block plane
-    printBlocks();
+    {
+        METRICS_SPAN(getPlane(), Span::shelf);
+        //shelfCompress<Layout>();
+        shelfY<Layout>();
+        shelfZ<Layout>();
+    }
+    METRICS_COUNT(getPlane(), Counter::blocksAfterShelf, blocks.countValid());
+}
+
+// quoted name of a stored ID, which is only local to the parent block when IDs are wide
+inline const string& ParentBlock::getQuotedTag(uchar ID) const
+{
+    return settings->tt->getQuotedTag(globalIDs.empty() ? ID : globalIDs[ID]);
 }
 
 // for debugging
 // print out each Block as a single block
 inline void ParentBlock::printBlocks()
 {
-    for (auto& block : blocks)
+    numBlocksPrinted = (uint)blocks.countValid();
+
+    if (settings->outputFormat == OutputFormat::binary)
     {
-        if (!block.isValid)
-            continue;
+        BinaryFormat::writeParentBlockStart(output, (originWS / settings->pBlockDim.cast<uint>()).cast<ushort>(), numBlocksPrinted);
+
+        blocks.forEachValid([this](uint block)
+        {
+            output.writeBinaryBlock(blocks.subVolumes[block].origin, blocks.subVolumes[block].size, blocks.IDs[block]);
+        });
 
-        cout << (block.subVolume.origin + originWS).to_string() + "," + block.subVolume.size.to_string() + ",'" + tt->
-	        getTag(block.ID) + "'\n";
+        return;
     }
+
+    blocks.forEachValid([this](uint block)
+    {
+        output.writeBlock(blocks.subVolumes[block].origin.cast<uint>() + originWS, blocks.subVolumes[block].size, getQuotedTag(blocks.IDs[block]));
+    });
 }
 
 inline void ParentBlock::printWholeParentBlock()
 {
-    cout << originWS.to_string() + "," + pBlockDim.to_string() + ",'" + tt->getTag(blocks[0].ID) + "'\n";
+    numBlocksPrinted = 1;
+
+    if (settings->outputFormat == OutputFormat::binary)
+    {
+        BinaryFormat::writeParentBlockStart(output, (originWS / settings->pBlockDim.cast<uint>()).cast<ushort>(), 1);
+        output.writeBinaryBlock({ 0, 0, 0 }, settings->pBlockDim, uniformID);
+        return;
+    }
+
+    output.writeBlock(originWS, settings->pBlockDim, getQuotedTag(uniformID));
+}
+
+// copy blocks found in the cache by storeVoxels, ready to print
+inline void ParentBlock::useCachedBlocks()
+{
+    for (size_t block = 0; block < cachedBlocks->IDs.size(); block++)
+        blocks.push(cachedBlocks->origins[block], cachedBlocks->sizes[block], cachedBlocks->IDs[block], 0);
 }
 
-inline bool ParentBlock::allSameTag()
+// keep the stored voxels and the blocks they were printed as for later parent blocks with the same voxels
+void ParentBlock::cacheBlocks()
 {
-    const uchar firstID = blocks[0].ID;
+    const vec3<ushort> pBlockDim = settings->pBlockDim;
+    auto entry = make_shared<BlockCache::Entry>();
+    entry->hash = storedHash;
 
-    for (size_t i = 1; i <= blocks.size(); i++)
+    entry->ids.resize(pBlockDim.volume());
+    uchar* row = entry->ids.data();
+    for (ushort z = 0; z < pBlockDim.z; z++)
     {
-        if (blocks[i].ID != firstID)
-            return false;
+        for (ushort y = 0; y < pBlockDim.y; y++, row += pBlockDim.x)
+            memcpy(row, storedIDs + z * storedPlaneStride + y * storedRowStride, pBlockDim.x);
     }
 
-    return true;
+    blocks.forEachValid([this, &entry](uint block)
+    {
+        entry->origins.push_back(blocks.subVolumes[block].origin);
+        entry->sizes.push_back(blocks.subVolumes[block].size);
+        entry->IDs.push_back(blocks.IDs[block]);
+    });
+
+    settings->cache->insert(entry);
 }
 
 // update variables to be ready for reading next block plane
 void ParentBlock::reset(int numActivePlanes)
 {
     // move 1 parent block size up Z
-    originWS.z += pBlockDim.z * numActivePlanes;
+    originWS.z += settings->pBlockDim.z * numActivePlanes;
 
     blocks.clear();
+    output.clear();
+    numBlocksPrinted = 0;
+    uniform = false;
+    storedIDs = nullptr;
+    cachedBlocks.reset();
+    globalIDs.clear();
 
     currentIndex = 0;
 }
 
+// which plane of parent blocks this is in, counting up Z
+inline uint ParentBlock::getPlane() const
+{
+    return originWS.z / settings->pBlockDim.z;
+}
+
+uint ParentBlock::getNumBlocks() const
+{
+    return numBlocksPrinted;
+}
+
+BlockList& ParentBlock::getBlocks()
+{
+    return blocks;
+}
+
+vec3<uint> ParentBlock::getOrigin() const
+{
+    return originWS;
+}
+
+void ParentBlock::moveTo(vec3<uint> origin)
+{
+    originWS = origin;
+}
+
+// printed blocks from the last call to compressPrint
+const BlockWriter& ParentBlock::getOutput() const
+{
+    return output;
+}
+
+template <typename Layout>
 void ParentBlock::insertBlockLine(vec3<ushort> origin, ushort length, uchar ID)
 {
+    IndexVolume<typename Layout::Index>& blockIndices = getIndexVolume<typename Layout::Index>();
+
     // Index the block will be stored at
-    uint blockIndex = (uint)blocks.size();
+    typename Layout::Index blockIndex = (typename Layout::Index)blocks.size();
 
     // store an n*1*1 line at origin of the found length
-    blocks.push_back({ true, { origin, { length, 1, 1 } }, ID, currentIndex });
+    blocks.push(origin, { length, 1, 1 }, ID, currentIndex);
 
     blockIndices[currentIndex] = blockIndex;
     currentIndex++;
 
     // set voxels in 3D volume to point at the index of the block it represents
-    for (int i=1; i<length; i++)
+    fill_n(blockIndices.indices.begin() + currentIndex, length - 1, IndexVolume<typename Layout::Index>::nullIndex);
+    currentIndex += length - 1;
+}
+
+// store a grid of tag IDs as lines of voxels
+// 'ids' is the parent block's first voxel, rows and XY planes are the given distances apart
+void ParentBlock::storeVoxels(const uchar* ids, size_t rowStride, size_t planeStride)
+{
+    // voxels seen before need no lines, their blocks are printed straight from the cache
+    if (settings->cache != nullptr && settings->cache->shouldLookUp(originWS.x / settings->pBlockDim.x, originWS.y / settings->pBlockDim.y))
     {
-        blockIndices[currentIndex] = NULL_INDEX;
-        currentIndex++;
+        storedIDs = ids;
+        storedRowStride = rowStride;
+        storedPlaneStride = planeStride;
+        storedHash = BlockCache::hashVoxels(ids, settings->pBlockDim, rowStride, planeStride);
+
+        cachedBlocks = settings->cache->find(storedHash, ids, settings->pBlockDim, rowStride, planeStride);
+        if (cachedBlocks)
+        {
+            METRICS_COUNT(getPlane(), Counter::voxels, settings->pBlockDim.volume());
+            return;
+        }
+    }
+
+    (this->*settings->storeKernel)(ids, rowStride, planeStride);
+}
+
+// wide IDs are renumbered in the order they appear so the uchar kernels and cache can be used unchanged
+// returns false, storing nothing, when the parent block has more than 256 different tags
+bool ParentBlock::storeVoxels(const ushort* ids, size_t rowStride, size_t planeStride)
+{
+    // local ID of every wide ID, 0 when not seen yet in this parent block
+    thread_local vector<ushort> localPlusOne(65536, 0);
+
+    const vec3<ushort> pBlockDim = settings->pBlockDim;
+    localIDs.resize(pBlockDim.volume());
+    globalIDs.clear();
+
+    uchar* local = localIDs.data();
+    for (ushort z = 0; z < pBlockDim.z; z++)
+    {
+        for (ushort y = 0; y < pBlockDim.y; y++)
+        {
+            const ushort* row = ids + z * planeStride + y * rowStride;
+            for (ushort x = 0; x < pBlockDim.x; x++)
+            {
+                ushort& id = localPlusOne[row[x]];
+                if (id == 0)
+                {
+                    if (globalIDs.size() == 256)
+                    {
+                        for (ushort globalID : globalIDs)
+                            localPlusOne[globalID] = 0;
+                        globalIDs.clear();
+                        return false;
+                    }
+
+                    globalIDs.push_back(row[x]);
+                    id = (ushort)globalIDs.size();
+                }
+
+                *local++ = (uchar)(id - 1);
+            }
+        }
     }
+
+    // leave the map clear for the next parent block
+    for (ushort globalID : globalIDs)
+        localPlusOne[globalID] = 0;
+
+    storeVoxels(localIDs.data(), pBlockDim.x, (size_t)pBlockDim.x * pBlockDim.y);
+    return true;
+}
+
+template <typename Layout>
+void ParentBlock::storeUniformRows(uint numRows, uchar ID)
+{
+    for (uint row = 0; row < numRows; row++)
+        insertBlockLine<Layout>({ 0, (ushort)(row % Layout::sizeY), (ushort)(row / Layout::sizeY) }, Layout::sizeX, ID);
+}
+
+template <typename Layout>
+void ParentBlock::storeLines(const uchar* ids, size_t rowStride, size_t planeStride)
+{
+    Layout::bind(settings->pBlockDim.x, settings->pBlockDim.y, settings->pBlockDim.z);
+
+    // where each line of a row starts, followed by the end of the row
+    // kept per thread so storing a parent block allocates nothing, only grows for a wider parent block
+    thread_local vector<ushort> runStarts;
+    if (runStarts.size() < (size_t)Layout::sizeX + 1)
+        runStarts.resize((size_t)Layout::sizeX + 1);
+
+    // rows are only stored once one differs from the first voxel, a parent block of one tag stores nothing
+    const uchar firstID = ids[0];
+    bool stillUniform = true;
+    uint numUniformRows = 0;
+
+    // each voxel along z
+    for (ushort a = 0; a < Layout::sizeZ; a++)
+    {
+        // each voxel inside pBlock y
+        for (ushort c = 0; c < Layout::sizeY; c++)
+        {
+            const uchar* row = ids + a * planeStride + c * rowStride;
+
+            // find lines of tags by breaking lines when the next tag changes
+            // always break the line when crossing a parent block boundary
+            const uint numRuns = RunFinder::findRuns(row, Layout::sizeX, runStarts.data());
+            runStarts[numRuns] = Layout::sizeX;
+
+            if (stillUniform)
+            {
+                if (numRuns == 1 && row[0] == firstID)
+                {
+                    numUniformRows++;
+                    continue;
+                }
+
+                stillUniform = false;
+                storeUniformRows<Layout>(numUniformRows, firstID);
+            }
+
+            for (uint run = 0; run < numRuns; run++)
+            {
+                const ushort start = runStarts[run];
+                insertBlockLine<Layout>({ start, c, a }, (ushort)(runStarts[run + 1] - start), row[start]);
+            }
+        }
+    }
+
+    uniform = stillUniform;
+    uniformID = firstID;
+
+    // a uniform parent block is one run per row
+    METRICS_COUNT(getPlane(), Counter::voxels, (uint64_t)Layout::sizeX * Layout::sizeY * Layout::sizeZ);
+    METRICS_COUNT(getPlane(), Counter::runs, uniform ? (uint64_t)Layout::sizeY * Layout::sizeZ : blocks.size());
 }
@@ -3,13 +3,32 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <limits>
+#include <bit>
+#include <cstdint>
 #include "vec3.h"
+#include "BlockLayout.h"
+#include "BlockWriter.h"
+#include "BinaryFormat.h"
 #include "TagTable.h"
+#include "CompressionEngine.h"
+#include "BlockCache.h"
+#include "Metrics.h"
 #include "uDataTypes.h"
 
 using namespace std;
 
-const uint NULL_INDEX = 0xFFFFFFFF;
+// which block covers each voxel of a parent block, by the block's position in its BlockList
+// 16 bit indices are used whenever a parent block has too few voxels to need more
+template <typename Index>
+struct IndexVolume
+{
+	static constexpr Index nullIndex = numeric_limits<Index>::max();		// voxel is inside a line but not at its start
+
+	vector<Index> indices;
+
+	Index& operator[](size_t voxel) { return indices[voxel]; }
+};
 
 // enum to easily reference an axis
 enum class Axis { x, y, z };
@@ -22,45 +41,178 @@ struct SubVolume
 	vec3<ushort> size;
 };
 
-struct Block
+// blocks of a parent block with one array per field, so each pass only loads the fields it reads
+// merged blocks stay in the arrays but have their valid bit cleared
+struct BlockList
 {
-	bool isValid;
-	SubVolume subVolume;
-	uchar ID;
-	unsigned long index;
+	vector<SubVolume> subVolumes;		// origin is local to the parent block
+	vector<uchar> IDs;
+	vector<uint> indices;				// 1D index of the voxel at the block's origin
+	vector<uint64_t> validBits;			// bit i is set while block i is valid
+
+	size_t size() const;
+	void push(vec3<ushort> origin, vec3<ushort> size, uchar ID, uint index);
+	void invalidate(uint block);
+	size_t countValid() const;
+	void clear();
+	template <typename Visit> void forEachValid(Visit visit) const;
 };
 
 class ParentBlock
 {
+public:
+	// everything that is the same for every parent block of a model
+	// each model being compressed has its own, parent blocks created without one share those set up by setup()
+	struct Settings
+	{
+		vec3<ushort> pBlockDim = { 1, 1, 1 };			// number of voxels per dimension in a parent block
+		const TagNames* tt = nullptr;					// names of global tag IDs, only needed for text output
+		OutputFormat outputFormat = OutputFormat::text;	// whether blocks are printed as text or binary
+		bool useNarrowIndices = true;					// parent blocks are small enough for 16 bit block indices
+		const char* kernelName = "";					// which layout the kernels were specialised for
+		void (ParentBlock::*compressKernel)() = nullptr;
+		void (ParentBlock::*storeKernel)(const uchar* ids, size_t rowStride, size_t planeStride) = nullptr;
+		const CompressionEngine* engine = CompressionEngine::getDefault();	// merges the lines of parent blocks with more than one tag
+		BlockCache* cache = nullptr;					// blocks of repeated parent blocks, null to compress every one
+
+		Settings() {}
+		Settings(vec3<ushort> dimensions, const TagNames* tagNames, OutputFormat format, bool specialise = true);
+	};
+
 private:
-	static vec3<ulong> translations;		// offsets to move through 1D array in 3D 
-	static TagTable* tt;							// access to global tag IDs/names
-	static vec3<ushort> pBlockDim;					// number of voxels per dimension in a parent block
+	static Settings sharedSettings;					// used by the command line program
+	const Settings* settings;
 	uint currentIndex;								// next empty index to read voxels into
-	vec3<ushort> originWS{};						// offset from global origin to local origin
-	vector<Block> blocks;
-	vector<uint> blockIndices;
-
-	static uint convert3DIndexTo1D(const vec3<ushort>& position);
-	void fillSubVolume(uint newValue, const SubVolume& subVolume);
-	void refreshBlockIndices();
-	void mergeUpY(Block& block, const SubVolume& subVolume);
-	void mergeUpZ(Block& block, const SubVolume& subVolume);
-	bool shelfCompressY(const SubVolume& subVolume, uint index, uchar topID);
-	bool shelfCompressZ(const SubVolume& subVolume, uint index, uchar topID);
-	void shelfY();
-	void shelfZ();
-	void shelfCompress();
-	void greedyCompressY();
-	void greedyCompressZ();
+	vec3<uint> originWS{};							// offset from global origin to local origin
+	BlockList blocks;
+	IndexVolume<ushort> narrowIndices;				// only the one matching useNarrowIndices is allocated
+	IndexVolume<uint> wideIndices;
+	BlockWriter output;								// printed blocks waiting to be written in order
+	uint numBlocksPrinted = 0;						// blocks in output
+	bool uniform = false;							// every voxel stored is uniformID, no lines were stored
+	uchar uniformID = 0;
+	const uchar* storedIDs = nullptr;				// voxels given to storeVoxels, left in place until the parent block is written
+	size_t storedRowStride = 0;
+	size_t storedPlaneStride = 0;
+	uint64_t storedHash = 0;
+	shared_ptr<const BlockCache::Entry> cachedBlocks;	// set instead of storing lines when the voxels were seen before
+	vector<uchar> localIDs;							// wide IDs of the stored voxels renumbered from 0, kernels only handle uchar IDs
+	vector<ushort> globalIDs;						// wide ID of each local ID, empty when IDs are already global
+
+	template <typename Layout> static void selectKernels(Settings& settings, const char* name);
+	template <typename Layout> static uint convert3DIndexTo1D(const vec3<ushort>& position);
+	template <typename Index> IndexVolume<Index>& getIndexVolume();
+	template <typename Layout> void fillSubVolume(typename Layout::Index newValue, const SubVolume& subVolume);
+	template <typename Layout> void refreshBlockIndices();
+	template <typename Layout> void mergeUpY(uint block, const SubVolume& subVolume);
+	template <typename Layout> void mergeUpZ(uint block, const SubVolume& subVolume);
+	template <typename Layout> bool shelfCompressY(const SubVolume& subVolume, uint index, uchar topID);
+	template <typename Layout> bool shelfCompressZ(const SubVolume& subVolume, uint index, uchar topID);
+	template <typename Layout> void shelfY();
+	template <typename Layout> void shelfZ();
+	template <typename Layout> void shelfCompress();
+	template <typename Layout> void greedyCompressY();
+	template <typename Layout> void greedyCompressZ();
+	template <typename Layout> void compress();
+	template <typename Layout> void insertBlockLine(vec3<ushort> origin, ushort length, uchar ID);
+	template <typename Layout> void storeUniformRows(uint numRows, uchar ID);
+	template <typename Layout> void storeLines(const uchar* ids, size_t rowStride, size_t planeStride);
+	const string& getQuotedTag(uchar ID) const;
 	void printBlocks();
 	void printWholeParentBlock();
-	bool allSameTag();
+	void useCachedBlocks();
+	uint getPlane() const;
+	void cacheBlocks();
 
 public:
-	ParentBlock(vec3<ushort> _originWS);
-	static void setup(vec3<ushort> dimensions, TagTable* planeTagTable);
-	void compressPrint();
+	ParentBlock(vec3<uint> _originWS);
+	ParentBlock(vec3<uint> _originWS, const Settings& _settings);
+	static void setup(vec3<ushort> dimensions, const TagNames* planeTagNames, OutputFormat format, bool specialise = true);
+	static const char* getKernelName();
+	static void setEngine(const CompressionEngine* compressionEngine);
+	static const CompressionEngine* getEngine();
+	vec3<ushort> getDimensions() const;
+	void compressPrint();							// compressBlocks then printCompressed
+	void compressBlocks();
+	void printCompressed();
+	void greedyShelfCompress();						// the original kernels, specialised for the parent block size
+	BlockList& getBlocks();							// for engines to replace lines with compressed blocks
+	template <typename Visit> void forEachCompressed(Visit visit);	// visit(origin, size, ID) for each block after compressBlocks, origins in the volume, IDs local for wide IDs
+	const BlockWriter& getOutput() const;
+	uint getNumBlocks() const;						// blocks printed by the last call to compressPrint
+	vec3<uint> getOrigin() const;
 	void reset(int numActivePlanes);
-	void insertBlockLine(vec3<ushort> origin, ushort length, uchar ID);
-};
\ No newline at end of file
+	void moveTo(vec3<uint> origin);					// for strips, which do not just move up Z
+	void storeVoxels(const uchar* ids, size_t rowStride, size_t planeStride);	// split a grid of tag IDs into lines
+	bool storeVoxels(const ushort* ids, size_t rowStride, size_t planeStride);	// wide IDs, false if there are more than 256 different in the parent block
+};
+inline size_t BlockList::size() const
+{
+	return IDs.size();
+}
+
+inline void BlockList::push(vec3<ushort> origin, vec3<ushort> size, uchar ID, uint index)
+{
+	// new blocks start valid
+	if (IDs.size() % 64 == 0)
+		validBits.push_back(0);
+	validBits.back() |= 1ull << (IDs.size() % 64);
+
+	subVolumes.push_back({ origin, size });
+	IDs.push_back(ID);
+	indices.push_back(index);
+}
+
+inline void BlockList::invalidate(uint block)
+{
+	validBits[block / 64] &= ~(1ull << (block % 64));
+}
+
+inline size_t BlockList::countValid() const
+{
+	size_t numValid = 0;
+	for (uint64_t bits : validBits)
+		numValid += popcount(bits);
+
+	return numValid;
+}
+
+inline void BlockList::clear()
+{
+	subVolumes.clear();
+	IDs.clear();
+	indices.clear();
+	validBits.clear();
+}
+
+// call visit(block) for every valid block in order, skipping 64 invalid blocks at a time
+// 'visit' may invalidate the block it is given
+template <typename Visit>
+inline void BlockList::forEachValid(Visit visit) const
+{
+	for (size_t word = 0; word < validBits.size(); word++)
+	{
+		uint64_t bits = validBits[word];
+		while (bits != 0)
+		{
+			visit((uint)(word * 64 + countr_zero(bits)));
+			bits &= bits - 1;
+		}
+	}
+}
+
+// blocks as compressBlocks left them, a uniform parent block is one block
+template <typename Visit>
+inline void ParentBlock::forEachCompressed(Visit visit)
+{
+	if (uniform)
+	{
+		visit(originWS, settings->pBlockDim, uniformID);
+		return;
+	}
+
+	blocks.forEachValid([this, &visit](uint block)
+	{
+		visit(blocks.subVolumes[block].origin.cast<uint>() + originWS, blocks.subVolumes[block].size, blocks.IDs[block]);
+	});
+}
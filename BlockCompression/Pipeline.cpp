@@ -0,0 +1,115 @@
+#include "Pipeline.h"
+
+#include <chrono>
+#include <thread>
+#include "MemoryUsage.h"
+
+template <typename ID>
+Pipeline<ID>::Pipeline(uint numPlanes) :
+    freePlanes(numPlanes),
+    readPlanes(numPlanes),
+    compressedPlanes(numPlanes),
+    readStage({ "read", 0, 0 }),
+    compressStage({ "compress", 0, 0 }),
+    writeStage({ "write", 0, 0 }),
+    totalSeconds(0)
+{
+    // never need more planes than the volume has
+    numPlanes = max(1u, min(numPlanes, BlockPlane<ID>::getNumPlanes()));
+
+    // BlockPlanes take their Z position from how many exist, so create all before reading any
+    for (uint i = 0; i < numPlanes; i++)
+        planes.push_back(make_unique<BlockPlane<ID>>());
+
+    // planes are used strictly in turn so each moves up by numPlanes parent blocks after writing
+    for (auto& plane : planes)
+        freePlanes.push(plane.get());
+}
+
+// take the next plane from a queue, recording how long the stage sat idle
+template <typename ID>
+inline BlockPlane<ID>* Pipeline<ID>::waitForPlane(BlockingQueue<BlockPlane<ID>*>& queue, Stage& stage)
+{
+    auto start = chrono::steady_clock::now();
+    BlockPlane<ID>* plane = queue.pop();
+    stage.stallSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    return plane;
+}
+
+// do one stage's work on a plane, recording how long it took
+template <typename ID>
+inline void Pipeline<ID>::runTimed(BlockPlane<ID>* plane, void (BlockPlane<ID>::*work)(), Stage& stage)
+{
+    auto start = chrono::steady_clock::now();
+    (plane->*work)();
+    stage.workSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename ID>
+void Pipeline<ID>::runReadStage()
+{
+    // stop when all planes have been read
+    while (BlockPlane<ID>::canRead())
+    {
+        BlockPlane<ID>* plane = waitForPlane(freePlanes, readStage);
+        runTimed(plane, &BlockPlane<ID>::readBlockPlane, readStage);
+        readPlanes.push(plane);
+    }
+}
+
+template <typename ID>
+void Pipeline<ID>::runCompressStage()
+{
+    for (uint i = 0; i < BlockPlane<ID>::getNumPlanes(); i++)
+    {
+        BlockPlane<ID>* plane = waitForPlane(readPlanes, compressStage);
+        runTimed(plane, &BlockPlane<ID>::compressBlockPlane, compressStage);
+        compressedPlanes.push(plane);
+    }
+}
+
+template <typename ID>
+void Pipeline<ID>::runWriteStage()
+{
+    for (uint i = 0; i < BlockPlane<ID>::getNumPlanes(); i++)
+    {
+        BlockPlane<ID>* plane = waitForPlane(compressedPlanes, writeStage);
+        runTimed(plane, &BlockPlane<ID>::writeBlockPlane, writeStage);
+        freePlanes.push(plane);
+    }
+
+    BlockPlane<ID>::finishOutput();
+}
+
+template <typename ID>
+void Pipeline<ID>::run()
+{
+    auto start = chrono::steady_clock::now();
+
+    // writing happens on the calling thread
+    thread readThread(&Pipeline::runReadStage, this);
+    thread compressThread(&Pipeline::runCompressStage, this);
+    runWriteStage();
+
+    readThread.join();
+    compressThread.join();
+
+    totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename ID>
+void Pipeline<ID>::printStats(ostream& out) const
+{
+    out << "pipeline: " << planes.size() << " planes, " << totalSeconds << " s total\n";
+    out << "  compression engine: " << ParentBlock::getEngine()->getName() << ", " << BlockPlane<ID>::getNumBlocksWritten() << " blocks\n";
+    out << "  compression kernels: " << ParentBlock::getKernelName() << "\n";
+    BlockCache::shared().printStats(out);
+    out << "  peak memory: " << MemoryUsage::getPeakBytes() / 1048576 << " MB\n";
+
+    for (const Stage* stage : { &readStage, &compressStage, &writeStage })
+        out << "  " << stage->name << " stage worked for " << stage->workSeconds << " s, stalled for " << stage->stallSeconds << " s\n";
+}
+
+template class Pipeline<uchar>;
+template class Pipeline<ushort>;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "BlockPlane.h"
+#include "BlockingQueue.h"
+
+using namespace std;
+
+// runs reading, compressing and writing of block planes at the same time
+// a ring of BlockPlanes moves through the stages, each stage on its own thread
+template <typename ID>
+class Pipeline
+{
+private:
+	// time one stage spent working and waiting for a plane from the stage before it
+	struct Stage
+	{
+		const char* name;
+		double workSeconds;
+		double stallSeconds;
+	};
+
+	vector<unique_ptr<BlockPlane<ID>>> planes;			// ring of planes, must all exist before any is read
+	BlockingQueue<BlockPlane<ID>*> freePlanes;			// planes ready to be read into
+	BlockingQueue<BlockPlane<ID>*> readPlanes;			// planes ready to be compressed
+	BlockingQueue<BlockPlane<ID>*> compressedPlanes;	// planes ready to be written
+	Stage readStage;
+	Stage compressStage;
+	Stage writeStage;
+	double totalSeconds;
+
+	BlockPlane<ID>* waitForPlane(BlockingQueue<BlockPlane<ID>*>& queue, Stage& stage);
+	void runTimed(BlockPlane<ID>* plane, void (BlockPlane<ID>::*work)(), Stage& stage);
+	void runReadStage();
+	void runCompressStage();
+	void runWriteStage();
+
+public:
+	Pipeline(uint numPlanes);
+	void run();											// process every plane in the volume
+	void printStats(ostream& out) const;
+};
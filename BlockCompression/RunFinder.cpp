@@ -0,0 +1,155 @@
+#include "RunFinder.h"
+
+#include "Simd.h"
+
+RunFinder::RunFunction RunFinder::runFunction = RunFinder::findRunsScalar;
+const char* RunFinder::name = "scalar";
+
+// compare the rest of a row one voxel at a time
+static inline uint finishRuns(const uchar* row, uint e, uint length, ushort* starts, uint numRuns)
+{
+    for (; e < length; e++)
+    {
+        if (row[e] != row[e - 1])
+            starts[numRuns++] = (ushort)e;
+    }
+
+    return numRuns;
+}
+
+uint RunFinder::findRunsScalar(const uchar* row, uint length, ushort* starts)
+{
+    starts[0] = 0;
+    return finishRuns(row, 1, length, starts, 1);
+}
+
+#ifdef SIMD_X86
+
+// bit i is set when current[i] differs from the voxel before it
+TARGET_SSE2 static inline uint64_t findChanges16(__m128i current, __m128i previous)
+{
+    return ~(uint)_mm_movemask_epi8(_mm_cmpeq_epi8(current, previous)) & 0xFFFF;
+}
+
+TARGET_SSE2 static inline uint storeRunStarts(uint64_t changed, uint offset, ushort* starts, uint numRuns)
+{
+    while (changed != 0)
+    {
+        starts[numRuns++] = (ushort)(offset + countTrailingZeros(changed));
+        changed &= changed - 1;
+    }
+
+    return numRuns;
+}
+
+// the first 16, or 8 in a short row, voxels are compared with themselves shifted along by one
+// the first voxel always starts a run, 'e' is set to the first voxel not yet compared
+TARGET_SSE2 static inline uint findFirstRuns(const uchar* row, uint length, ushort* starts, uint& e)
+{
+    starts[0] = 0;
+
+    if (length >= 16)
+    {
+        const __m128i current = _mm_loadu_si128((const __m128i*)row);
+        e = 16;
+        return storeRunStarts(findChanges16(current, _mm_bslli_si128(current, 1)) & ~1ull, 0, starts, 1);
+    }
+
+    if (length >= 8)
+    {
+        const __m128i current = _mm_loadl_epi64((const __m128i*)row);
+        e = 8;
+        return storeRunStarts(findChanges16(current, _mm_bslli_si128(current, 1)) & 0xFE, 0, starts, 1);
+    }
+
+    e = 1;
+    return 1;
+}
+
+// every voxel is compared with the one before it, so a uniform row is a handful of compares and no stores
+TARGET_SSE2 uint RunFinder::findRunsSSE2(const uchar* row, uint length, ushort* starts)
+{
+    uint e;
+    uint numRuns = findFirstRuns(row, length, starts, e);
+
+    // 16 voxels per block, each loaded again one voxel earlier to compare against
+    for (; e + 16 <= length; e += 16)
+    {
+        const __m128i current = _mm_loadu_si128((const __m128i*)(row + e));
+        const __m128i previous = _mm_loadu_si128((const __m128i*)(row + e - 1));
+        numRuns = storeRunStarts(findChanges16(current, previous), e, starts, numRuns);
+    }
+
+    return finishRuns(row, e, length, starts, numRuns);
+}
+
+TARGET_AVX2 uint RunFinder::findRunsAVX2(const uchar* row, uint length, ushort* starts)
+{
+    uint e;
+    uint numRuns = findFirstRuns(row, length, starts, e);
+
+    // 32 voxels per block
+    for (; e + 32 <= length; e += 32)
+    {
+        const __m256i current = _mm256_loadu_si256((const __m256i*)(row + e));
+        const __m256i previous = _mm256_loadu_si256((const __m256i*)(row + e - 1));
+        const uint64_t changed = ~(uint)_mm256_movemask_epi8(_mm256_cmpeq_epi8(current, previous)) & 0xFFFFFFFFull;
+        numRuns = storeRunStarts(changed, e, starts, numRuns);
+    }
+
+    // one last block of 16 before the scalar tail
+    if (e + 16 <= length)
+    {
+        const __m128i current = _mm_loadu_si128((const __m128i*)(row + e));
+        const __m128i previous = _mm_loadu_si128((const __m128i*)(row + e - 1));
+        numRuns = storeRunStarts(findChanges16(current, previous), e, starts, numRuns);
+        e += 16;
+    }
+
+    return finishRuns(row, e, length, starts, numRuns);
+}
+
+#else
+
+uint RunFinder::findRunsSSE2(const uchar* row, uint length, ushort* starts)
+{
+    return findRunsScalar(row, length, starts);
+}
+
+uint RunFinder::findRunsAVX2(const uchar* row, uint length, ushort* starts)
+{
+    return findRunsScalar(row, length, starts);
+}
+
+#endif
+
+void RunFinder::setup()
+{
+    // the CPU never changes, so choose once however many models are set up and from however many threads
+    static const bool chosen = []()
+    {
+        if (cpuHasAVX2())
+        {
+            runFunction = findRunsAVX2;
+            name = "avx2";
+        }
+        else if (cpuHasSSE2())
+        {
+            runFunction = findRunsSSE2;
+            name = "sse2";
+        }
+        else
+        {
+            runFunction = findRunsScalar;
+            name = "scalar";
+        }
+
+        return true;
+    }();
+    (void)chosen;
+}
+
+const char* RunFinder::getName()
+{
+    return name;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "uDataTypes.h"
+
+using namespace std;
+
+// finds where runs of equal tag IDs start in a row of voxels
+// vector versions compare 16 or 32 neighbouring pairs at once and give exactly the same runs as the scalar version
+class RunFinder
+{
+public:
+	// writes the start of every run in row[0, length) to 'starts' and returns how many there are
+	// the first run always starts at 0, 'starts' must have room for 'length' entries
+	using RunFunction = uint(*)(const uchar* row, uint length, ushort* starts);
+
+	static void setup();								// pick the widest instruction set the CPU supports
+	static const char* getName();						// name of the picked instruction set
+
+	static uint findRuns(const uchar* row, uint length, ushort* starts)
+	{
+		return runFunction(row, length, starts);
+	}
+
+	static uint findRunsScalar(const uchar* row, uint length, ushort* starts);
+	static uint findRunsSSE2(const uchar* row, uint length, ushort* starts);
+	static uint findRunsAVX2(const uchar* row, uint length, ushort* starts);
+
+private:
+	static RunFunction runFunction;
+	static const char* name;
+};
@@ -0,0 +1,32 @@
+#include "Simd.h"
+
+bool cpuHasSSE2()
+{
+#if !defined(SIMD_X86)
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool cpuHasAVX2()
+{
+#if !defined(SIMD_X86)
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+
+    // OS must save the AVX registers on context switch
+    __cpuid(info, 1);
+    const bool osSavesYMM = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+    __cpuidex(info, 7, 0);
+    return osSavesYMM && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+// helpers shared by the hand vectorised kernels
+// each kernel is compiled for several instruction sets and one is picked at runtime
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// GCC/Clang need per-function targets to use intrinsics beyond the compile flags
+// MSVC allows any intrinsic without them
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+bool cpuHasSSE2();
+bool cpuHasAVX2();
+
+// index of lowest set bit, mask must not be 0
+inline int countTrailingZeros(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+#if defined(_M_X64)
+    _BitScanForward64(&index, mask);
+#else
+    if (!_BitScanForward(&index, (unsigned long)mask))
+    {
+        _BitScanForward(&index, (unsigned long)(mask >> 32));
+        index += 32;
+    }
+#endif
+    return (int)index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
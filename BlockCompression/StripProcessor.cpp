@@ -0,0 +1,69 @@
+#include "StripProcessor.h"
+
+#include <chrono>
+#include "MemoryUsage.h"
+
+template <typename ID>
+StripProcessor<ID>::StripProcessor(size_t memoryBudget) :
+    stripRows(BlockPlane<ID>::getStripRows(memoryBudget)),
+    strip(stripRows),
+    numStrips(BlockPlane<ID>::getNumStrips(stripRows)),
+    spill(nullptr),
+    totalSeconds(0)
+{
+    // a whole plane fits, nothing to spill
+    if (numStrips == 1)
+        return;
+
+    spill = tmpfile();
+    if (spill == nullptr)
+    {
+        cerr << "Could not create a spill file for --memory-budget\n";
+        exit(2);
+    }
+}
+
+template <typename ID>
+StripProcessor<ID>::~StripProcessor()
+{
+    if (spill != nullptr)
+        fclose(spill);
+}
+
+template <typename ID>
+void StripProcessor<ID>::run()
+{
+    auto start = chrono::steady_clock::now();
+
+    while (BlockPlane<ID>::canRead())
+    {
+        strip.readStrips(spill);
+
+        for (uint i = 0; i < numStrips; i++)
+        {
+            // the first strip was kept in memory while reading
+            if (i != 0)
+                strip.loadStrip(spill, i);
+
+            strip.compressBlockPlane();
+            strip.writeBlockPlane();
+        }
+    }
+
+    BlockPlane<ID>::finishOutput();
+
+    totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename ID>
+void StripProcessor<ID>::printStats(ostream& out) const
+{
+    out << "strips: " << numStrips << " per plane of " << stripRows << " rows of parent blocks, " << totalSeconds << " s total\n";
+    out << "  compression engine: " << ParentBlock::getEngine()->getName() << ", " << BlockPlane<ID>::getNumBlocksWritten() << " blocks\n";
+    out << "  compression kernels: " << ParentBlock::getKernelName() << "\n";
+    BlockCache::shared().printStats(out);
+    out << "  peak memory: " << MemoryUsage::getPeakBytes() / 1048576 << " MB\n";
+}
+
+template class StripProcessor<uchar>;
+template class StripProcessor<ushort>;
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+#include <iostream>
+#include "BlockPlane.h"
+
+using namespace std;
+
+// processes planes in strips of rows of parent blocks so memory stays within a budget however wide the volume is
+// the input is still read once in order, rows of strips not yet being compressed wait in a temporary spill file
+// planes are read, compressed and written one after another instead of overlapping like the Pipeline
+template <typename ID>
+class StripProcessor
+{
+private:
+	uint stripRows;								// rows of parent blocks in a strip, as many as fit in the budget
+	BlockPlane<ID> strip;						// holds one strip at a time
+	uint numStrips;								// strips in every plane, the last can have fewer rows
+	FILE* spill;								// strips after the first of the plane being processed, null with one strip
+	double totalSeconds;
+
+public:
+	StripProcessor(size_t memoryBudget);
+	~StripProcessor();
+	void run();									// process every plane in the volume
+	void printStats(ostream& out) const;
+};
@@ -0,0 +1,53 @@
+#include "TagEdges.h"
+
+#include <algorithm>
+
+// one table of prefix counts of tag changes for each axis of ids
+void TagEdges::build(const vector<uchar>& ids, const uint* size)
+{
+    copy(size, size + 3, axisSize);
+
+    bool seen[256] = {};
+    numTags = 0;
+    for (uchar ID : ids)
+    {
+        numTags += !seen[ID];
+        seen[ID] = true;
+    }
+
+    tableSize = (size[0] + 1) * (size[1] + 1) * (size[2] + 1);
+    prefixCounts.assign(3 * (size_t)tableSize, 0);
+
+    const size_t strides[3] = { 1, size[0], (size_t)size[0] * size[1] };
+    for (int axis = 0; axis < 3; axis++)
+    {
+        uint* table = prefixCounts.data() + axis * (size_t)tableSize;
+        const uchar* ID = ids.data();
+
+        for (uint z = 0; z < size[2]; z++)
+        {
+            for (uint y = 0; y < size[1]; y++)
+            {
+                for (uint x = 0; x < size[0]; x++, ID++)
+                {
+                    const uint position[3] = { x, y, z };
+                    const bool changes = position[axis] > 0 && *ID != *(ID - strides[axis]);
+
+                    table[prefixIndex(x + 1, y + 1, z + 1)] = changes
+                        + table[prefixIndex(x, y + 1, z + 1)]
+                        + table[prefixIndex(x + 1, y, z + 1)]
+                        + table[prefixIndex(x + 1, y + 1, z)]
+                        - table[prefixIndex(x, y, z + 1)]
+                        - table[prefixIndex(x, y + 1, z)]
+                        - table[prefixIndex(x + 1, y, z)]
+                        + table[prefixIndex(x, y, z)];
+                }
+            }
+        }
+    }
+}
+
+uint TagEdges::getNumTags() const
+{
+    return numTags;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include "uDataTypes.h"
+
+using namespace std;
+
+// whether any box of a parent block is all one tag, read in constant time
+// a box is one tag when no voxel in it differs from the voxel before it along any axis, without the box's low faces
+// holds a 3D prefix count of those changes for each axis, so memory is 12 bytes per voxel however many tags there are
+class TagEdges
+{
+private:
+	vector<uint> prefixCounts;		// per axis, how many voxels in [0, x) * [0, y) * [0, z) differ from the one before them on it
+	uint tableSize = 0;				// entries in one axis' prefix count table
+	uint axisSize[3] = {};
+	uint numTags = 0;
+
+	uint prefixIndex(uint x, uint y, uint z) const;
+	uint count(int axis, const uint* low, const uint* high) const;	// changes along axis inside [low, high)
+
+public:
+	void build(const vector<uchar>& ids, const uint* size);	// ids are row-major with the given size per axis
+	uint getNumTags() const;								// different tags in the parent block
+	bool isOneTag(const uint* low, const uint* high) const;	// whether [low, high) is all one tag
+};
+// prefix count tables have an extra layer of zeros at the start of every axis
+inline uint TagEdges::prefixIndex(uint x, uint y, uint z) const
+{
+	return x + (axisSize[0] + 1) * (y + (axisSize[1] + 1) * z);
+}
+
+inline uint TagEdges::count(int axis, const uint* low, const uint* high) const
+{
+	const uint* table = prefixCounts.data() + (size_t)axis * tableSize;
+
+	// inclusion-exclusion over the 8 corners, wrapping arithmetic cancels out
+	return table[prefixIndex(high[0], high[1], high[2])]
+		- table[prefixIndex(low[0], high[1], high[2])]
+		- table[prefixIndex(high[0], low[1], high[2])]
+		- table[prefixIndex(high[0], high[1], low[2])]
+		+ table[prefixIndex(low[0], low[1], high[2])]
+		+ table[prefixIndex(low[0], high[1], low[2])]
+		+ table[prefixIndex(high[0], low[1], low[2])]
+		- table[prefixIndex(low[0], low[1], low[2])];
+}
+
+inline bool TagEdges::isOneTag(const uint* low, const uint* high) const
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// the first voxel on each axis is compared with one outside the box, skip it
+		uint inner[3] = { low[0], low[1], low[2] };
+		inner[axis]++;
+		if (inner[axis] < high[axis] && count(axis, inner, high) != 0)
+			return false;
+	}
+
+	return true;
+}
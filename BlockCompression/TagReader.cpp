@@ -1,39 +1,200 @@
 #include "TagReader.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include "LineParsing.h"
+#include "ThreadPool.h"
+#include "VoxelFormat.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 //#define DEBUG
 
-#ifdef DEBUG
-FILE* pFile;
+vector<char> TagReader::charBuffer;
+const char* TagReader::iter = nullptr;
+const char* TagReader::bufferEnd = nullptr;
+bool TagReader::mapped = false;
+const char* TagReader::mappingBegin = nullptr;
+const char* TagReader::releasedEnd = nullptr;
+vector<string_view> TagReader::rowTags;
+bool TagReader::binaryInput = false;
+vector<string> TagReader::binaryTags;
+uint TagReader::binaryIDBytes = 1;
+vector<ushort> TagReader::binaryTranslation;
+bool TagReader::binaryIDsMatch = false;
+vector<uchar> TagReader::binaryBytes;
+
+// number of tags scanned at once when parsing a chunk
+#define CHUNK_BATCH 1024
+
+// smallest chunk of a mapped input worth giving its own task
+#define MIN_CHUNK_BYTES 65536
+
+// a chunk of a mapped block plane, starts and ends on line boundaries
+template <typename ID>
+struct InputChunk
+{
+    const char* begin;
+    const char* end;
+    unsigned long long firstVoxel;    // index of the chunk's first voxel within the block plane
+    unsigned long long numVoxels;
+    BasicTagTable<ID> tagTable;           // IDs local to this chunk, merged into the global table afterwards
+
+    // most chunks have the tags seen so far, so their tables start with room for that many
+    InputChunk(int expectedTags) : tagTable(false, expectedTags) {}
+};
+
+// map all of stdin into memory so tags can be viewed without copying
+// only possible when stdin is redirected from a regular file
+bool TagReader::mapInput()
+{
+#ifdef _WIN32
+    return false;
+#else
+    struct stat info;
+    if (fstat(STDIN_FILENO, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+        return false;
+
+    // stdin may not start at the beginning of the file
+    off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (offset < 0 || offset >= info.st_size)
+        return false;
+
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    // every char is read once from front to back
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+
+    iter = (const char*)mapping + offset;
+    bufferEnd = (const char*)mapping + info.st_size;
+    mappingBegin = releasedEnd = (const char*)mapping;
+
+    return true;
 #endif
+}
+
+// a mapping's pages stay resident once read, which for big inputs can be more memory than everything else
+// pages are read only so dropping them is free, they would be read from the file again if touched
+void TagReader::releaseReadInput()
+{
+#ifndef _WIN32
+    if (mappingBegin == nullptr)
+        return;
+
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const char* end = mappingBegin + (iter - mappingBegin) / pageSize * pageSize;
+    if (end > releasedEnd)
+    {
+        madvise((void*)releasedEnd, end - releasedEnd, MADV_DONTNEED);
+        releasedEnd = end;
+    }
+#endif
+}
+
+// move unread chars from 'keep' onwards to the front of the buffer and stream more in behind them
+// 'keep' and 'iter' are updated to point at the same chars after the move
+// returns false once there is nothing more to read
+bool TagReader::refillBuffer(const char*& keep)
+{
+    if (mapped)
+        return false;
+
+    size_t keepOffset = keep - charBuffer.data();
+    size_t iterOffset = iter - keep;
+    size_t numKept = bufferEnd - keep;
+
+    // a single tag fills the whole buffer, make room for more
+    if (numKept == charBuffer.size())
+        charBuffer.resize(charBuffer.size() * 2);
 
-#define SKIP_AMOUNT 14
+    memmove(charBuffer.data(), charBuffer.data() + keepOffset, numKept);
+    size_t numRead = fread(charBuffer.data() + numKept, sizeof(char), charBuffer.size() - numKept, stdin);
 
-char TagReader::charBuffer[MAX_LINE_LENGTH];
-char* TagReader::bufferEnd;
+    keep = charBuffer.data();
+    iter = keep + iterOffset;
+    bufferEnd = keep + numKept + numRead;
 
-// fill initial buffer and return description line
+    return numRead != 0;
+}
+
+// prepare input and return description line
 string TagReader::setup()
 {
-    // fill initial buffer
 #ifdef DEBUG
-    fopen_s(&pFile, "D:/Documents/UNI/2021/Semester 2/Software Engineering Project/runner/the_stratal_one_42000000_14x10x12.csv", "r");
-    fread(charBuffer, sizeof(char), MAX_LINE_LENGTH, pFile);
-#else
-    fread(charBuffer, sizeof(char), MAX_LINE_LENGTH, stdin);
+    freopen("D:/Documents/UNI/2021/Semester 2/Software Engineering Project/runner/the_stratal_one_42000000_14x10x12.csv", "rb", stdin);
+#endif
+
+    TagScanner::setup();
+
+#ifdef _WIN32
+    // binary input must not have its bytes translated
+    _setmode(_fileno(stdin), _O_BINARY);
 #endif
 
-    // set end point
-    bufferEnd = charBuffer + MAX_LINE_LENGTH;
+    // read straight from the file if possible, otherwise fill initial buffer
+    mapped = mapInput();
+    if (!mapped)
+    {
+        charBuffer.resize(MAX_LINE_LENGTH);
+        iter = bufferEnd = charBuffer.data();
+        refillBuffer(iter);
+    }
+
+    return readDescription();
+}
+
+// read input already in memory instead of stdin, the chars must stay in place until reading finishes
+string TagReader::setup(const char* begin, const char* end)
+{
+    TagScanner::setup();
+
+    // memory is read exactly like a mapped file
+    mapped = true;
+    mappingBegin = releasedEnd = nullptr;
+    iter = begin;
+    bufferEnd = end;
+    binaryTranslation.clear();
+
+    return readDescription();
+}
+
+// volume description from the first line of text input or the header of binary input
+string TagReader::readDescription()
+{
+    // binary input describes the volume in its header instead
+    binaryInput = bufferEnd - iter >= 4 && memcmp(iter, VOXEL_MAGIC, 4) == 0;
+    if (binaryInput)
+        return readBinaryHeader();
 
     // find end of first line which contains volume description
-    char* endLine = charBuffer + 1;
-    while (*endLine != '\n')
+    const char* begin_str = iter;
+    const char* endLine = (const char*)memchr(begin_str, '\n', bufferEnd - begin_str);
+    while (endLine == nullptr)
     {
-        endLine++;
+        iter = bufferEnd;
+        if (!refillBuffer(begin_str))
+        {
+            cerr << "Input is missing the volume description line\n";
+            exit(2);
+        }
+
+        endLine = (const char*)memchr(iter, '\n', bufferEnd - iter);
     }
 
     // Save description line into a string
-    string description = string(charBuffer, endLine);
+    string description = string(begin_str, endLine);
+    iter = endLine + 1;
 
     // Replace comma characters with whitespace
     for (auto& c : description)
@@ -45,76 +206,492 @@ string TagReader::setup()
     return description;
 }
 
+// sizes of the volume and parent blocks from a description line, the volume may be wider than a ushort
+bool TagReader::parseDescription(const string& description, vec3<uint>& volumeDim, vec3<ushort>& pBlockDim)
+{
+    // skip anything written before the first dimension
+    size_t firstDigit = description.find_first_of("0123456789");
+    stringstream ss(firstDigit == string::npos ? string() : description.substr(firstDigit));
+
+    uint sizes[6] = {};
+    for (uint& size : sizes)
+    {
+        if (!(ss >> size))
+            return false;
+        for (char c = (char)ss.peek(); c == ',' || c == ' '; c = (char)ss.peek())
+            ss.get();
+    }
+
+    volumeDim = { sizes[0], sizes[1], sizes[2] };
+    pBlockDim = { (ushort)sizes[3], (ushort)sizes[4], (ushort)sizes[5] };
+    return sizes[3] <= USHRT_MAX && sizes[4] <= USHRT_MAX && sizes[5] <= USHRT_MAX;
+}
+
+int TagReader::getNumHeaderTags()
+{
+    return binaryInput ? (int)binaryTags.size() : -1;
+}
+
 // get next tag name
-// looks through buffer finding tags
-// if hits buffer ends, reads more chars
-string TagReader::getNextTagName()
+string_view TagReader::getNextTagName()
+{
+    string_view tag;
+    getNextTagRow(&tag, 1);
+
+    return tag;
+}
+
+// get the next 'count' tag names
+// scans the buffer for whole rows of tags at once
+// if hits buffer end, streams in more chars
+void TagReader::getNextTagRow(string_view* tags, uint count)
+{
+    uint found = TagScanner::scan(iter, bufferEnd, tags, count);
+
+    while (found < count)
+    {
+        // keep tags already found in this row, they are moved along with the unread chars
+        const char* keep = found != 0 ? tags[0].data() : iter;
+        const char* oldKeep = keep;
+
+        if (!refillBuffer(keep))
+        {
+            cerr << "Input ended before all voxels were read\n";
+            exit(2);
+        }
+
+        for (uint i = 0; i < found; i++)
+            tags[i] = string_view(keep + (tags[i].data() - oldKeep), tags[i].size());
+
+        found += TagScanner::scan(iter, bufferEnd, tags + found, count - found);
+    }
+}
+
+// read the tags of the next 'count' voxels in row-major order and store their IDs
+// 'count' must be a whole number of rows
+// returns where the IDs are, which is inside the input rather than 'ids' when they can be used without copying
+template <typename ID>
+const ID* TagReader::readTagIDs(ID* ids, unsigned long long count, vec3<uint> volumeDim, BasicTagTable<ID>& tagTable)
+{
+    if (binaryInput)
+        return readBinaryTagIDs(ids, count, tagTable);
+
+    if (mapped)
+        readMappedTagIDs(ids, count, volumeDim, tagTable);
+    else
+        readStreamedTagIDs(ids, count, volumeDim, tagTable);
+
+    return ids;
+}
+
+// read rows one after another as they are streamed in
+template <typename ID>
+void TagReader::readStreamedTagIDs(ID* ids, unsigned long long count, vec3<uint> volumeDim, BasicTagTable<ID>& tagTable)
+{
+    rowTags.resize(volumeDim.x);
+
+    for (unsigned long long i = 0; i < count; i += volumeDim.x)
+    {
+        getNextTagRow(rowTags.data(), volumeDim.x);
+
+        for (const string_view& tag : rowTags)
+            *ids++ = tagTable.getID(tag);
+    }
+}
+
+// row-major index within the volume of the voxel described on a line
+// lines that do not describe a voxel are treated as being after every voxel
+static unsigned long long lineVoxelIndex(const char* line, const char* end, vec3<uint> volumeDim)
+{
+    unsigned long long x, y, z;
+    if (!parseCoordinate(line, end, x) || !parseCoordinate(line, end, y) || !parseCoordinate(line, end, z))
+        return ~0ull;
+
+    return x + y * volumeDim.x + z * volumeDim.x * (unsigned long long)volumeDim.y;
+}
+
+// split the block plane into chunks at line boundaries and parse every chunk in parallel
+// each voxel's position is known from its description so chunks can be placed without reading the ones before
+template <typename ID>
+void TagReader::readMappedTagIDs(ID* ids, unsigned long long count, vec3<uint> volumeDim, BasicTagTable<ID>& tagTable)
+{
+    // iter always sits at the start of a line between block planes
+    const char* planeBegin = iter;
+    const unsigned long long firstVoxel = lineVoxelIndex(planeBegin, bufferEnd, volumeDim);
+    const unsigned long long endVoxel = firstVoxel + count;
+
+    if (firstVoxel == ~0ull)
+    {
+        cerr << "Input ended before all voxels were read\n";
+        exit(2);
+    }
+
+    // binary search for the first line after this block plane
+    const char* low = planeBegin;
+    const char* high = bufferEnd;
+    while (true)
+    {
+        const char* line = nextLineStart(low + (high - low) / 2, high);
+
+        // no line starts in the upper half, try the first line after low
+        if (line == high)
+        {
+            line = nextLineStart(low, high);
+            if (line == high)
+                break;
+        }
+
+        if (lineVoxelIndex(line, high, volumeDim) < endVoxel)
+            low = line;
+        else
+            high = line;
+    }
+    const char* planeEnd = high;
+
+    // split into roughly equal chunks, a few per thread to even out uneven chunks
+    ThreadPool& pool = ThreadPool::shared();
+    const size_t planeBytes = planeEnd - planeBegin;
+    const size_t numChunks = max((size_t)1, min((size_t)pool.getNumThreads() * 4, planeBytes / MIN_CHUNK_BYTES));
+
+    vector<InputChunk<ID>> chunks;
+    chunks.reserve(numChunks);
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        InputChunk<ID>& chunk = chunks.emplace_back(tagTable.getTotalTags());
+        chunk.begin = i == 0 ? planeBegin : nextLineStart(planeBegin + i * planeBytes / numChunks - 1, planeEnd);
+        chunk.firstVoxel = chunk.begin == planeEnd ? count : lineVoxelIndex(chunk.begin, planeEnd, volumeDim) - firstVoxel;
+
+        if (i != 0)
+        {
+            chunks[i - 1].end = chunk.begin;
+            chunks[i - 1].numVoxels = chunk.firstVoxel - chunks[i - 1].firstVoxel;
+        }
+    }
+    chunks.back().end = planeEnd;
+    chunks.back().numVoxels = count - chunks.back().firstVoxel;
+
+    // voxels must be in row-major order for chunks to line up
+    for (const InputChunk<ID>& chunk : chunks)
+    {
+        if (chunk.firstVoxel + chunk.numVoxels > count || chunk.numVoxels > count)
+        {
+            cerr << "Voxels are not sorted in row-major order\n";
+            exit(2);
+        }
+    }
+
+    // parse every chunk using its own tag IDs
+    pool.parallelFor(numChunks, [&](size_t i)
+    {
+        InputChunk<ID>& chunk = chunks[i];
+        string_view batch[CHUNK_BATCH];
+
+        const char* c = chunk.begin;
+        ID* chunkIDs = ids + chunk.firstVoxel;
+        unsigned long long remaining = chunk.numVoxels;
+
+        while (remaining != 0)
+        {
+            uint batchSize = (uint)min(remaining, (unsigned long long)CHUNK_BATCH);
+            uint found = TagScanner::scan(c, chunk.end, batch, batchSize);
+
+            for (uint j = 0; j < found; j++)
+                *chunkIDs++ = chunk.tagTable.getID(batch[j]);
+
+            remaining -= found;
+
+            // chunk has fewer tags than its position says it should
+            if (found < batchSize)
+                break;
+        }
+
+        chunk.numVoxels -= remaining;
+    });
+
+    // translate chunk IDs into global IDs, only chunks that disagree with the global table need rewriting
+    vector<vector<ID>> translations(numChunks);
+    vector<bool> needsRewrite(numChunks, false);
+    unsigned long long numRead = 0;
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        numRead += chunks[i].numVoxels;
+
+        for (int localID = 0; localID < chunks[i].tagTable.getTotalTags(); localID++)
+        {
+            ID globalID = tagTable.getID(*chunks[i].tagTable.getTagPointer(localID));
+            translations[i].push_back(globalID);
+            needsRewrite[i] = needsRewrite[i] || globalID != localID;
+        }
+    }
+
+    if (numRead != count)
+    {
+        // missing voxels either ran off the end of the input or are somewhere else in it
+        const bool atEnd = lineVoxelIndex(planeEnd, bufferEnd, volumeDim) == ~0ull;
+        cerr << (atEnd ? "Input ended before all voxels were read\n" : "Voxels are not sorted in row-major order\n");
+        exit(2);
+    }
+
+    pool.parallelFor(numChunks, [&](size_t i)
+    {
+        if (!needsRewrite[i])
+            return;
+
+        const ID* translation = translations[i].data();
+        ID* chunkIDs = ids + chunks[i].firstVoxel;
+        for (unsigned long long j = 0; j < chunks[i].numVoxels; j++)
+            chunkIDs[j] = translation[chunkIDs[j]];
+    });
+
+    iter = planeEnd;
+}
+
+// make sure 'length' chars from iter onwards are in the buffer and return where they start
+const char* TagReader::need(size_t length)
 {
-    bool reading = false;
-    char* begin_str = nullptr;
+    while ((size_t)(bufferEnd - iter) < length)
+    {
+        if (!refillBuffer(iter))
+        {
+            cerr << "Input ended before all voxels were read\n";
+            exit(2);
+        }
+    }
 
-    bool usedCache = false;
-    string cachedString;
+    return iter;
+}
+
+inline ushort TagReader::readUShort()
+{
+    const uchar* c = (const uchar*)need(2);
+    iter += 2;
 
-    static char* iter = charBuffer;
+    return (ushort)(c[0] | c[1] << 8);
+}
+
+inline uint TagReader::readUInt()
+{
+    uint low = readUShort();
+    return low | (uint)readUShort() << 16;
+}
+
+// read the binary header and return it as a volume description line
+string TagReader::readBinaryHeader()
+{
+    need(4);
+    iter += 4;
+
+    // version 2 only differs in having wider fields
+    const ushort version = readUShort();
+    if (version != VOXEL_VERSION && version != VOXEL_VERSION_WIDE)
+    {
+        cerr << "Unsupported binary voxel format version\n";
+        exit(2);
+    }
+    const bool wide = version == VOXEL_VERSION_WIDE;
+
+    string description;
+    for (int i = 0; i < 3; i++)
+        description += to_string(wide ? readUInt() : readUShort()) + " ";
+    for (int i = 0; i < 3; i++)
+        description += to_string(readUShort()) + " ";
+
+    binaryTags.resize(wide ? readUInt() : readUShort());
+    for (string& name : binaryTags)
+    {
+        ushort length = readUShort();
+        name = string(need(length), length);
+        iter += length;
+    }
+
+    binaryIDBytes = VoxelFormat::needsWideIDs((int)binaryTags.size()) ? 2 : 1;
+
+    return description;
+}
+
+// IDs are stored exactly as they are used so a mapped input needs no copying
+// a corrupt or truncated file can have IDs past the end of its tag list, which would be used to index it
+// the largest ID is found first so the loops have no early exit and vectorise
+void TagReader::checkBinaryIDs(const uchar* fileIDs, unsigned long long count)
+{
+    const size_t numTags = binaryTags.size();
+    uint largestID = 0;
+
+    if (binaryIDBytes == 1)
+    {
+        // every byte is a valid ID
+        if (numTags >= 256)
+            return;
+
+        uchar largest = 0;
+        for (unsigned long long i = 0; i < count; i++)
+            largest = max(largest, fileIDs[i]);
+        largestID = largest;
+    }
+    else
+    {
+        for (unsigned long long i = 0; i < count; i++)
+            largestID = max(largestID, (uint)(fileIDs[2 * i] | fileIDs[2 * i + 1] << 8));
+    }
+
+    if (count != 0 && largestID >= numTags)
+    {
+        cerr << "Input has a voxel with tag ID " << largestID << " but its header only lists " << numTags << " tags\n";
+        exit(2);
+    }
+}
+
+template <typename ID>
+const ID* TagReader::readBinaryTagIDs(ID* ids, unsigned long long count, BasicTagTable<ID>& tagTable)
+{
+    if (binaryIDBytes > sizeof(ID))
+    {
+        cerr << "Input has more than 256 tags so needs --wide-tags\n";
+        exit(2);
+    }
+
+    // the global table usually starts empty so gives every tag the same ID as the file
+    if (binaryTranslation.empty())
+    {
+        binaryIDsMatch = true;
+
+        for (size_t id = 0; id < binaryTags.size(); id++)
+        {
+            binaryTranslation.push_back(tagTable.getID(binaryTags[id]));
+            binaryIDsMatch = binaryIDsMatch && binaryTranslation[id] == id;
+        }
+    }
+
+    const unsigned long long numBytes = count * binaryIDBytes;
+    const uchar* fileIDs;
+
+    if (mapped)
+    {
+        if ((unsigned long long)(bufferEnd - iter) < numBytes)
+        {
+            cerr << "Input ended before all voxels were read\n";
+            exit(2);
+        }
+
+        fileIDs = (const uchar*)iter;
+        iter += numBytes;
+        checkBinaryIDs(fileIDs, count);
+
+        if constexpr (sizeof(ID) == 1)
+        {
+            if (binaryIDsMatch)
+                return fileIDs;
+
+            memcpy(ids, fileIDs, count);
+        }
+    }
+    else
+    {
+        // one byte IDs are read straight into place, others are widened from a copy
+        uchar* bytes = (uchar*)ids;
+        if (sizeof(ID) != 1)
+        {
+            binaryBytes.resize(numBytes);
+            bytes = binaryBytes.data();
+        }
+
+        // use what is already buffered then read the rest
+        unsigned long long numBuffered = min(numBytes, (unsigned long long)(bufferEnd - iter));
+        memcpy(bytes, iter, numBuffered);
+        iter += numBuffered;
+
+        if (fread(bytes + numBuffered, 1, numBytes - numBuffered, stdin) != numBytes - numBuffered)
+        {
+            cerr << "Input ended before all voxels were read\n";
+            exit(2);
+        }
+
+        fileIDs = bytes;
+        checkBinaryIDs(fileIDs, count);
+    }
+
+    // two byte IDs are little-endian
+    if constexpr (sizeof(ID) != 1)
+    {
+        if (binaryIDBytes == 1)
+        {
+            for (unsigned long long i = 0; i < count; i++)
+                ids[i] = fileIDs[i];
+        }
+        else
+        {
+            for (unsigned long long i = 0; i < count; i++)
+                ids[i] = (ID)(fileIDs[2 * i] | fileIDs[2 * i + 1] << 8);
+        }
+    }
+
+    if (!binaryIDsMatch)
+    {
+        for (unsigned long long i = 0; i < count; i++)
+            ids[i] = (ID)binaryTranslation[ids[i]];
+    }
+
+    return ids;
+}
+
+// read the position and tag of the next voxel, which can be anywhere in the volume
+// slower than reading whole rows so only meant for short lists such as changed voxels
+// returns false once the input has ended
+bool TagReader::getNextVoxel(vec3<ushort>& position, string_view& tag)
+{
+    if (binaryInput)
+    {
+        cerr << "Voxels must be listed as text\n";
+        exit(2);
+    }
 
-    // continuously read into buffer
-    // loop is broken by finishing a tag
     while (true)
     {
-        // while not hit buffer end
-        while (iter < bufferEnd)
+        // make sure the whole line is in the buffer
+        const char* lineEnd = (const char*)memchr(iter, '\n', bufferEnd - iter);
+        while (lineEnd == nullptr)
         {
-            // found start/finish of tag
-            if (*iter == '\'')
+            size_t numScanned = bufferEnd - iter;
+            if (!refillBuffer(iter))
             {
-                // found finish
-                if (reading)
-                {
-                    reading = false;
-
-                    // move over minimum distance of next tag position/size
-                    iter += SKIP_AMOUNT;
-
-                    // concatenate cached start to tag name if needed
-                    if (usedCache)
-                    {
-                        usedCache = false;
-                        return cachedString + string(begin_str, iter - SKIP_AMOUNT);
-                    }
-
-                    // extract tag between start and end point
-                    return string(begin_str, iter - SKIP_AMOUNT);
-                }
-                // found start
-                else
-                {
-                    reading = true;
-
-                    // save where tag starts
-                    begin_str = iter + 1;
-                }
+                lineEnd = bufferEnd;
+                break;
             }
-            
-            iter++;
+
+            lineEnd = (const char*)memchr(iter + numScanned, '\n', bufferEnd - iter - numScanned);
         }
 
-        // finished buffer, but didnt not finish reading tag, cache
-        if (reading)
+        if (iter == bufferEnd)
+            return false;
+
+        const char* line = iter;
+        iter = lineEnd == bufferEnd ? bufferEnd : lineEnd + 1;
+
+        // skip blank lines
+        unsigned long long x, y, z;
+        if (!parseCoordinate(line, lineEnd, x) || !parseCoordinate(line, lineEnd, y) || !parseCoordinate(line, lineEnd, z))
+            continue;
+
+        const char* open = (const char*)memchr(line, '\'', lineEnd - line);
+        const char* close = open == nullptr ? nullptr : (const char*)memchr(open + 1, '\'', lineEnd - open - 1);
+        if (close == nullptr)
         {
-            usedCache = true;
-            cachedString = string(begin_str, iter);
-            begin_str = charBuffer;
+            cerr << "Voxel " << x << "," << y << "," << z << " is missing its tag\n";
+            exit(2);
         }
 
-        iter -= MAX_LINE_LENGTH;
-#ifdef DEBUG
-        fread(charBuffer, sizeof(char), MAX_LINE_LENGTH, pFile);
-#else
-        fread(charBuffer, sizeof(char), MAX_LINE_LENGTH, stdin);
-#endif
+        if (x > USHRT_MAX || y > USHRT_MAX || z > USHRT_MAX)
+        {
+            cerr << "Voxel " << x << "," << y << "," << z << " is outside the volume\n";
+            exit(2);
+        }
+
+        position = { (ushort)x, (ushort)y, (ushort)z };
+        tag = string_view(open + 1, close - open - 1);
+
+        return true;
     }
+}
 
-    // never hit
-    return "";
-}
\ No newline at end of file
+template const uchar* TagReader::readTagIDs(uchar* ids, unsigned long long count, vec3<uint> volumeDim, TagTable& tagTable);
+template const ushort* TagReader::readTagIDs(ushort* ids, unsigned long long count, vec3<uint> volumeDim, WideTagTable& tagTable);
@@ -2,9 +2,14 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <cstdio>
+#include "TagScanner.h"
+#include "TagTable.h"
+#include "vec3.h"
 
-// how many chars will be read at once
+// how many chars will be read at once when input cannot be memory mapped
 #define MAX_LINE_LENGTH 1048576
 
 using namespace std;
@@ -12,11 +17,42 @@ using namespace std;
 class TagReader
 {
 private:
-	static char charBuffer[MAX_LINE_LENGTH];
-	static char* bufferEnd;
+	static vector<char> charBuffer;				// holds streamed input when stdin cannot be mapped
+	static const char* iter;					// next char to be scanned
+	static const char* bufferEnd;				// one past the last readable char
+	static bool mapped;							// whether input is read directly from a memory mapping
+	static const char* mappingBegin;			// start of the memory mapping of stdin, null when reading from memory
+	static const char* releasedEnd;				// mapped input before this has been given back to the OS
+
+	static vector<string_view> rowTags;			// tags of the row of voxels being read when streaming
+
+	static bool binaryInput;					// input is in the binary voxel format
+	static uint binaryIDBytes;					// bytes per voxel ID in binary input, 2 when it has more than 256 tags
+	static vector<string> binaryTags;			// tag names listed in the binary header
+	static vector<ushort> binaryTranslation;	// binary tag ID to global tag ID, empty until first read
+	static bool binaryIDsMatch;					// binary IDs are already the global IDs
+	static vector<uchar> binaryBytes;			// streamed binary IDs waiting to be widened
+
+	static bool mapInput();						// try to memory map stdin, fails for pipes and terminals
+	static bool refillBuffer(const char*& keep);	// stream more input, keeping everything from 'keep' onwards
+	template <typename ID> static void readMappedTagIDs(ID* ids, unsigned long long count, vec3<uint> volumeDim, BasicTagTable<ID>& tagTable);
+	template <typename ID> static void readStreamedTagIDs(ID* ids, unsigned long long count, vec3<uint> volumeDim, BasicTagTable<ID>& tagTable);
+	static const char* need(size_t length);		// make sure 'length' chars after iter are readable
+	static ushort readUShort();
+	static uint readUInt();
+	static string readBinaryHeader();
+	static void checkBinaryIDs(const uchar* fileIDs, unsigned long long count);	// exits if any ID has no tag in the header
+	template <typename ID> static const ID* readBinaryTagIDs(ID* ids, unsigned long long count, BasicTagTable<ID>& tagTable);
+	static string readDescription();
 
 public:
 	static string setup();
-	static string getNextTagName();
+	static string setup(const char* begin, const char* end);	// for benchmarks, read from memory instead of stdin
+	static bool parseDescription(const string& description, vec3<uint>& volumeDim, vec3<ushort>& pBlockDim);	// false unless every size is given
+	static int getNumHeaderTags();				// tags listed by binary input, -1 for text input which does not list them
+	static string_view getNextTagName();		// view is valid until the next call
+	static void getNextTagRow(string_view* tags, uint count);	// views are valid until the next call
+	static bool getNextVoxel(vec3<ushort>& position, string_view& tag);	// voxels in any order, view is valid until the next call
+	template <typename ID> static const ID* readTagIDs(ID* ids, unsigned long long count, vec3<uint> volumeDim, BasicTagTable<ID>& tagTable);
+	static void releaseReadInput();				// drop mapped pages already read, IDs returned into the mapping must not be used after
 };
-
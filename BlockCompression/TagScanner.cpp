@@ -0,0 +1,192 @@
+#include "TagScanner.h"
+
+#include <algorithm>
+#include "Simd.h"
+
+TagScanner::ScanFunction TagScanner::scanFunction = TagScanner::scanScalar;
+const char* TagScanner::name = "scalar";
+
+// progress of a scan, carried between blocks of chars
+struct ScanState
+{
+    const char* open;       // first char of the tag being read, null when between tags
+    const char* resume;     // quotes before this are inside the skipped gap after a tag
+    uint found;             // number of tags found so far
+};
+
+// walk the quotes marked in a block's bitmask, bit i is set if block[i] is a quote
+// returns true once 'count' tags have been found
+static inline bool consumeQuotes(uint64_t mask, const char* block, ScanState& state, string_view* tags, uint count)
+{
+    // ignore quotes inside the gap after the previous tag, like the scalar reader skipping over them
+    ptrdiff_t skip = state.resume - block;
+    if (skip > 0)
+        mask &= skip >= 64 ? 0 : ~0ull << skip;
+
+    while (mask != 0)
+    {
+        const char* quote = block + countTrailingZeros(mask);
+        mask &= mask - 1;
+
+        // found start
+        if (state.open == nullptr)
+        {
+            state.open = quote + 1;
+            continue;
+        }
+
+        // found finish
+        tags[state.found] = string_view(state.open, quote - state.open);
+        state.found++;
+        state.open = nullptr;
+        state.resume = quote + SKIP_AMOUNT;
+
+        if (state.found == count)
+            return true;
+
+        skip = state.resume - block;
+        mask &= skip >= 64 ? 0 : ~0ull << skip;
+    }
+
+    return false;
+}
+
+// scan remaining chars one at a time and report where the next scan should start
+static inline uint finishScan(const char* iter, const char*& begin, const char* end, ScanState& state, string_view* tags, uint count)
+{
+    iter = max(iter, state.resume);
+
+    while (iter < end)
+    {
+        if (*iter == '\'')
+        {
+            // found start
+            if (state.open == nullptr)
+            {
+                state.open = iter + 1;
+            }
+            // found finish
+            else
+            {
+                tags[state.found] = string_view(state.open, iter - state.open);
+                state.found++;
+                state.open = nullptr;
+
+                // move over minimum distance of next tag position/size
+                iter += SKIP_AMOUNT;
+
+                if (state.found == count)
+                {
+                    begin = min(iter, end);
+                    return count;
+                }
+
+                continue;
+            }
+        }
+
+        iter++;
+    }
+
+    // leave an unfinished tag to be scanned again once more chars are available
+    begin = state.open != nullptr ? state.open - 1 : end;
+    return state.found;
+}
+
+uint TagScanner::scanScalar(const char*& begin, const char* end, string_view* tags, uint count)
+{
+    ScanState state = { nullptr, begin, 0 };
+    return finishScan(begin, begin, end, state, tags, count);
+}
+
+#ifdef SIMD_X86
+
+TARGET_SSE2 uint TagScanner::scanSSE2(const char*& begin, const char* end, string_view* tags, uint count)
+{
+    ScanState state = { nullptr, begin, 0 };
+    const __m128i quote = _mm_set1_epi8('\'');
+
+    // 32 chars per block
+    const char* block = begin;
+    while (end - block >= 32)
+    {
+        const __m128i low = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)block), quote);
+        const __m128i high = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 16)), quote);
+        const uint64_t mask = (uint)_mm_movemask_epi8(low) | (uint)_mm_movemask_epi8(high) << 16;
+
+        if (consumeQuotes(mask, block, state, tags, count))
+        {
+            begin = min(state.resume, end);
+            return count;
+        }
+
+        // jump straight over gaps that cover whole blocks
+        block = state.open == nullptr ? max(block + 32, state.resume) : block + 32;
+    }
+
+    return finishScan(block, begin, end, state, tags, count);
+}
+
+TARGET_AVX2 uint TagScanner::scanAVX2(const char*& begin, const char* end, string_view* tags, uint count)
+{
+    ScanState state = { nullptr, begin, 0 };
+    const __m256i quote = _mm256_set1_epi8('\'');
+
+    // 64 chars per block
+    const char* block = begin;
+    while (end - block >= 64)
+    {
+        const __m256i low = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)block), quote);
+        const __m256i high = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(block + 32)), quote);
+        const uint64_t mask = (uint64_t)(uint)_mm256_movemask_epi8(low) | (uint64_t)(uint)_mm256_movemask_epi8(high) << 32;
+
+        if (consumeQuotes(mask, block, state, tags, count))
+        {
+            begin = min(state.resume, end);
+            return count;
+        }
+
+        // jump straight over gaps that cover whole blocks
+        block = state.open == nullptr ? max(block + 64, state.resume) : block + 64;
+    }
+
+    return finishScan(block, begin, end, state, tags, count);
+}
+
+#else
+
+uint TagScanner::scanSSE2(const char*& begin, const char* end, string_view* tags, uint count)
+{
+    return scanScalar(begin, end, tags, count);
+}
+
+uint TagScanner::scanAVX2(const char*& begin, const char* end, string_view* tags, uint count)
+{
+    return scanScalar(begin, end, tags, count);
+}
+
+#endif
+
+void TagScanner::setup()
+{
+    if (cpuHasAVX2())
+    {
+        scanFunction = scanAVX2;
+        name = "avx2";
+    }
+    else if (cpuHasSSE2())
+    {
+        scanFunction = scanSSE2;
+        name = "sse2";
+    }
+    else
+    {
+        scanFunction = scanScalar;
+        name = "scalar";
+    }
+}
+
+const char* TagScanner::getName()
+{
+    return name;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string_view>
+#include "uDataTypes.h"
+
+// minimum distance from the end of one tag to the start of the next
+// "'\n0,0,0,1,1,1,'" always separates 2 tags
+#define SKIP_AMOUNT 14
+
+using namespace std;
+
+// finds the quoted tags of voxel descriptions in a range of chars
+// vector versions test 32 or 64 chars at once and give exactly the same tags as the scalar version
+class TagScanner
+{
+public:
+	// reads up to 'count' tags from [begin, end) into 'tags' and returns how many were found
+	// 'begin' is moved to where the next scan should start
+	// if a tag is cut off by 'end', 'begin' is left on its opening quote
+	using ScanFunction = uint(*)(const char*& begin, const char* end, string_view* tags, uint count);
+
+	static void setup();								// pick the widest instruction set the CPU supports
+	static const char* getName();						// name of the picked instruction set
+
+	static uint scan(const char*& begin, const char* end, string_view* tags, uint count)
+	{
+		return scanFunction(begin, end, tags, count);
+	}
+
+	static uint scanScalar(const char*& begin, const char* end, string_view* tags, uint count);
+	static uint scanSSE2(const char*& begin, const char* end, string_view* tags, uint count);
+	static uint scanAVX2(const char*& begin, const char* end, string_view* tags, uint count);
+
+private:
+	static ScanFunction scanFunction;
+	static const char* name;
+};
@@ -1,64 +1,146 @@
 #include "TagTable.h"
 
-TagTable::TagTable()
-{
-    numTags = 0;
-    constexpr int numUniqueCharValues = 256;
-    names.reserve(numUniqueCharValues);
-}
-
 // Return the tag from an id
-string TagTable::getTag(const uchar id)
+string TagNames::getTag(uint id) const
 {
     return names[id];
 }
 
 // Return the tag from an id
-string* TagTable::getTagPointer(const uchar id)
+const string* TagNames::getTagPointer(uint id) const
 {
     return &names[id];
 }
 
-// Return the id if it is in the map
-// Otherwise insert to both maps
-uchar TagTable::getID(string tag)
+// Return the tag from an id with quotes around it
+const string& TagNames::getQuotedTag(uint id) const
+{
+    return quotedNames[id];
+}
+
+// public getter for number of held tags
+int TagNames::getTotalTags() const
+{
+    return numTags;
+}
+
+template <typename ID>
+BasicTagTable<ID>::BasicTagTable(bool stableNames, int expectedTags)
 {
-    // Set the next id
-    map<string, uchar>::iterator lookup = tags.find(tag);
+    // the global table's names are printed while new tags are added
+    if (stableNames)
+    {
+        names.reserve(MAX_TAGS);
+        quotedNames.reserve(MAX_TAGS);
+    }
+
+    size_t numSlots = MIN_SLOTS;
+    while (numSlots < 2 * (size_t)expectedTags && numSlots < 2 * (size_t)MAX_TAGS)
+        numSlots *= 2;
+    slots.resize(numSlots);
 
-    // 'tag' is in the map, return stored ID
-    if (lookup != tags.end())
+    reset();
+}
+
+// FNV-1a, tags are short so a simple byte hash is enough
+template <typename ID>
+inline uint BasicTagTable<ID>::hashTag(string_view tag)
+{
+    uint hash = 2166136261u;
+    for (char c : tag)
     {
-        return lookup->second;
+        hash ^= (uchar)c;
+        hash *= 16777619u;
     }
-    // else add to map and vector, return the new ID
-    else
+
+    return hash;
+}
+
+// Return the id if it is in the table
+// Otherwise insert to both the table and names
+template <typename ID>
+ID BasicTagTable<ID>::lookupID(string_view tag)
+{
+    const uint hash = hashTag(tag);
+
+    // linear probe until the tag or an empty slot is found
+    uint slotMask = (uint)slots.size() - 1;
+    uint slot = hash & slotMask;
+    while (slots[slot].id != -1)
     {
-        // Get a new id
-        uchar nextID = numTags;
+        // 'tag' is in the table, return stored ID
+        if (slots[slot].hash == hash && names[slots[slot].id] == tag)
+            return (ID)slots[slot].id;
 
-        // Add to the maps
-        tags[tag] = nextID;
-        names.push_back(tag);
+        slot = (slot + 1) & slotMask;
+    }
 
-        // Increment id for next tag
-        numTags++;
+    // else add to table and names, return the new ID
+    if (numTags == MAX_TAGS)
+    {
+        cerr << "Input has more than " << MAX_TAGS << " unique tags";
+        if (MAX_TAGS == 256)
+            cerr << ", use --wide-tags for up to 65536";
+        cerr << "\n";
+        exit(2);
+    }
 
-        return nextID;
+    // keep the table at most half full, the new tag's slot moves with it
+    if (2 * (size_t)(numTags + 1) > slots.size())
+    {
+        grow();
+        slotMask = (uint)slots.size() - 1;
+        slot = hash & slotMask;
+        while (slots[slot].id != -1)
+            slot = (slot + 1) & slotMask;
     }
+
+    // Get a new id
+    ID nextID = (ID)numTags;
+
+    slots[slot] = { hash, (int)nextID };
+    names.emplace_back(tag);
+    quotedNames.push_back("'" + names.back() + "'");
+
+    // Increment id for next tag
+    numTags++;
+
+    return nextID;
 }
 
-// public getter for number of held tags
-int TagTable::getTotalTags() const
+// double the number of slots, placing tags by their stored hash so none is hashed again
+template <typename ID>
+void BasicTagTable<ID>::grow()
 {
-    return numTags;
+    vector<Slot> oldSlots(slots.size() * 2, { 0, -1 });
+    slots.swap(oldSlots);
+
+    const uint slotMask = (uint)slots.size() - 1;
+    for (const Slot& old : oldSlots)
+    {
+        if (old.id == -1)
+            continue;
+
+        uint slot = old.hash & slotMask;
+        while (slots[slot].id != -1)
+            slot = (slot + 1) & slotMask;
+        slots[slot] = old;
+    }
 }
 
 // clear contents of a TagTable
-void TagTable::reset()
+template <typename ID>
+void BasicTagTable<ID>::reset()
 {
     numTags = 0;
+    lastID = 0;
+
+    for (Slot& slot : slots)
+        slot = { 0, -1 };
 
-    tags.clear();
     names.clear();
-}
\ No newline at end of file
+    quotedNames.clear();
+}
+
+template class BasicTagTable<uchar>;
+template class BasicTagTable<ushort>;
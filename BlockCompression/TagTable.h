@@ -4,25 +4,71 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <string_view>
 #include <iostream>
 #include <vector>
 #include "uDataTypes.h"
 
 using namespace std;
 
-class TagTable
+// names of the tags in a table, by ID
+// the same for every ID width so output can be written without knowing it
+class TagNames
 {
-private:
-    map<string, uchar> tags;
+protected:
     vector<string> names;
-    int numTags;
-    
+    vector<string> quotedNames;                         // names surrounded by quotes ready for output
+    int numTags = 0;
+
 public:
-    TagTable();
-    string getTag(uchar id);
-    string* getTagPointer(uchar id);
-    uchar getID(string tag);
+    string getTag(uint id) const;
+    const string* getTagPointer(uint id) const;
+    const string& getQuotedTag(uint id) const;
     int getTotalTags() const;
+};
+
+// gives every tag an ID, in the order tags are first seen
+// uchar IDs hold up to 256 tags, models with more use ushort IDs
+template <typename ID>
+class BasicTagTable : public TagNames
+{
+private:
+    static constexpr int MAX_TAGS = 1 << (8 * sizeof(ID));     // every ID must fit in an ID
+    static constexpr uint MIN_SLOTS = 16;                       // hash table is never more than half full, and doubles to stay so
+
+    // entry in the open addressing table
+    struct Slot
+    {
+        uint hash;
+        int id;                                         // -1 when the slot is empty
+    };
+
+    vector<Slot> slots;
+    ID lastID;                                          // ID returned by the previous lookup
+
+    static uint hashTag(string_view tag);
+    ID lookupID(string_view tag);
+    void grow();
+    
+public:
+    // stable names never move, so can be read while tags are added
+    // slots start with room for 'expectedTags', a 16 bit table sized for every tag would be 1 MB
+    BasicTagTable(bool stableNames = true, int expectedTags = 0);
+    ID getID(string_view tag);
     void reset();
-};
\ No newline at end of file
+};
+
+using TagTable = BasicTagTable<uchar>;
+using WideTagTable = BasicTagTable<ushort>;
+
+// Return the id of a tag, inserting it if it has not been seen before
+// neighbouring voxels usually share a tag so check the previous one first
+template <typename ID>
+inline ID BasicTagTable<ID>::getID(string_view tag)
+{
+    if (numTags != 0 && names[lastID] == tag)
+        return lastID;
+
+    lastID = lookupID(tag);
+    return lastID;
+}
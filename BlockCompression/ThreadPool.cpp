@@ -0,0 +1,129 @@
+#include "ThreadPool.h"
+
+TaskGroup::TaskGroup(ThreadPool& _pool) : pool(_pool), pending(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::run(function<void()> task)
+{
+    pending++;
+
+    {
+        lock_guard<mutex> lock(pool.queueMutex);
+        pool.tasks.push_back({ move(task), this });
+    }
+
+    pool.queueChanged.notify_one();
+}
+
+void TaskGroup::wait()
+{
+    while (pending != 0)
+    {
+        // run anything queued rather than sleep, this may include tasks of this group
+        if (pool.runPendingTask())
+            continue;
+
+        unique_lock<mutex> lock(pool.queueMutex);
+        pool.queueChanged.wait(lock, [this] { return pending == 0 || !pool.tasks.empty(); });
+    }
+}
+
+ThreadPool::ThreadPool(uint numThreads)
+{
+    stopping = false;
+
+    // calling thread does work while waiting so needs no worker
+    for (uint i = 1; i < numThreads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+
+    queueChanged.notify_all();
+
+    for (thread& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool(max(thread::hardware_concurrency(), 1u));
+    return pool;
+}
+
+uint ThreadPool::getNumThreads() const
+{
+    return (uint)workers.size() + 1;
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+            if (stopping && tasks.empty())
+                return;
+        }
+
+        runPendingTask();
+    }
+}
+
+bool ThreadPool::runPendingTask()
+{
+    Task task;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (tasks.empty())
+            return false;
+
+        task = move(tasks.front());
+        tasks.pop_front();
+    }
+
+    task.work();
+
+    // wake anyone waiting on the group once its last task is done
+    if (--task.group->pending == 0)
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queueChanged.notify_all();
+    }
+
+    return true;
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& body)
+{
+    atomic<size_t> next(0);
+
+    // every thread takes the next unclaimed index until none are left
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            body(i);
+    };
+
+    TaskGroup group(*this);
+    size_t numHelpers = min((size_t)workers.size(), count > 0 ? count - 1 : 0);
+    for (size_t i = 0; i < numHelpers; i++)
+        group.run(worker);
+
+    worker();
+    group.wait();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "uDataTypes.h"
+
+using namespace std;
+
+class ThreadPool;
+
+// set of tasks that can be waited on together
+// tasks may create and wait on their own groups without deadlocking
+class TaskGroup
+{
+private:
+	ThreadPool& pool;
+	atomic<size_t> pending;							// tasks queued or running
+
+	friend class ThreadPool;
+
+public:
+	TaskGroup(ThreadPool& _pool);
+	~TaskGroup();
+	void run(function<void()> task);				// queue a task to run on any thread
+	void wait();									// help run queued tasks until all of this group's tasks finish
+};
+
+// fixed set of worker threads sharing one queue of tasks
+class ThreadPool
+{
+private:
+	struct Task
+	{
+		function<void()> work;
+		TaskGroup* group;
+	};
+
+	vector<thread> workers;
+	deque<Task> tasks;
+	mutex queueMutex;
+	condition_variable queueChanged;				// signalled when a task is queued or a group finishes
+	bool stopping;
+
+	void workerLoop();
+	bool runPendingTask();							// run one queued task on this thread, false if none
+
+	friend class TaskGroup;
+
+public:
+	ThreadPool(uint numThreads);					// total threads including the caller of wait/parallelFor
+	~ThreadPool();
+	static ThreadPool& shared();					// pool sized to the number of hardware threads
+
+	uint getNumThreads() const;
+
+	// call body(i) for every i in [0, count) across all threads, returns when all are done
+	void parallelFor(size_t count, const function<void(size_t)>& body);
+};
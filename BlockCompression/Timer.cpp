@@ -11,13 +11,13 @@ Timer::Timer(string outputName, bool startImmediately = true)
 
 void Timer::start()
 {
-    m_StartTime = std::chrono::system_clock::now();
+    m_StartTime = std::chrono::steady_clock::now();
     running = true;
 }
 
 void Timer::stop()
 {
-    m_EndTime = std::chrono::system_clock::now();
+    m_EndTime = std::chrono::steady_clock::now();
     running = false;
 
     totalTime += Timer::elapsedMicroseconds();
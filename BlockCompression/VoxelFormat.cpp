@@ -0,0 +1,42 @@
+#include "VoxelFormat.h"
+
+#include <climits>
+
+// voxel IDs are written as ushorts when a uchar cannot hold them all
+bool VoxelFormat::needsWideIDs(int numTags)
+{
+    return numTags > 256;
+}
+
+// write everything that comes before the voxel IDs
+void VoxelFormat::writeHeader(BlockWriter& writer, vec3<uint> volumeDim, vec3<ushort> pBlockDim, const TagNames& tagNames)
+{
+    // version 1 is kept whenever it fits so existing readers still work
+    const bool wide = needsWideIDs(tagNames.getTotalTags()) || volumeDim.x > USHRT_MAX || volumeDim.y > USHRT_MAX || volumeDim.z > USHRT_MAX;
+
+    writer.writeChars(VOXEL_MAGIC, 4);
+    writer.writeUShort(wide ? VOXEL_VERSION_WIDE : VOXEL_VERSION);
+
+    for (uint size : { volumeDim.x, volumeDim.y, volumeDim.z })
+    {
+        if (wide)
+            writer.writeUInt(size);
+        else
+            writer.writeUShort((ushort)size);
+    }
+    writer.writeUShort(pBlockDim.x);
+    writer.writeUShort(pBlockDim.y);
+    writer.writeUShort(pBlockDim.z);
+
+    if (wide)
+        writer.writeUInt((uint)tagNames.getTotalTags());
+    else
+        writer.writeUShort((ushort)tagNames.getTotalTags());
+
+    for (int id = 0; id < tagNames.getTotalTags(); id++)
+    {
+        const string* name = tagNames.getTagPointer(id);
+        writer.writeUShort((ushort)name->size());
+        writer.writeChars(name->data(), name->size());
+    }
+}
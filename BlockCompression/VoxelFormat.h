@@ -0,0 +1,30 @@
+#pragma once
+
+#include "BlockWriter.h"
+#include "TagTable.h"
+#include "vec3.h"
+#include "uDataTypes.h"
+
+// Binary voxel input format
+//
+// All integers are little-endian.
+// header: "BCVX", ushort version, ushort volume size x/y/z, ushort parent block size x/y/z
+// tags:   ushort count, then count * (ushort length, chars of name), a voxel's ID is the index of its tag
+// voxels: uchar ID of every voxel in row-major order
+// text input is converted with 'executable --to-binary < dataset.txt > dataset.bin'
+//
+// version 2 is only written for models version 1 cannot describe, it differs in
+// header: uint volume size x/y/z
+// tags:   uint count
+// voxels: ushort ID of every voxel when there are more than 256 tags
+
+#define VOXEL_MAGIC "BCVX"
+#define VOXEL_VERSION 1
+#define VOXEL_VERSION_WIDE 2
+
+class VoxelFormat
+{
+public:
+	static bool needsWideIDs(int numTags);
+	static void writeHeader(BlockWriter& writer, vec3<uint> volumeDim, vec3<ushort> pBlockDim, const TagNames& tagNames);
+};
@@ -11,11 +11,17 @@ struct vec3
 	T y;
 	T z;
 
-	unsigned long long volume()
+	unsigned long long volume() const
 	{
 		return (unsigned long long)x * (unsigned long long)y * (unsigned long long)z;
 	}
 
+	template <typename U>
+	vec3<U> cast() const
+	{
+		return { (U)x, (U)y, (U)z };
+	}
+
 	T operator[] (int index)
 	{
 		switch (index) {
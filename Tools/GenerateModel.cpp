@@ -0,0 +1,324 @@
+// Generator of synthetic block models for testing at any scale
+// streams the model a row of voxels at a time so memory use does not depend on the volume size
+// every voxel's tag only depends on its position and the seed, so the same arguments always give the same model
+//
+// usage: GenerateModel --volume X,Y,Z --parent X,Y,Z [--tags N] [--noise P] [--layer T] [--seed S] [--binary] [--output FILE]
+//   --tags N    number of different tags, 1 to 65536 (default 8), over 256 needs --wide-tags to compress as text
+//               over 256, each column of parent blocks starts its layers at its own tag so the model uses all N,
+//               once it has enough columns, while a parent block only has its own layers and so stays under 256 tags
+//               unless the layers are much thinner than it is tall
+//   --noise P   chance of a voxel having a random tag instead of its layer's, 0 to 1 (default 0.05)
+//   --layer T   average thickness of the folded layers in voxels, 0 for a single layer (default 6)
+//   --seed S    seed of the noise and the folding (default 1)
+//   --binary    write the binary voxel format described in VoxelFormat.h instead of text
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BlockWriter.h"
+#include "TagTable.h"
+#include "VoxelFormat.h"
+#include "vec3.h"
+
+using namespace std;
+
+struct Settings
+{
+    vec3<uint> volumeDim = { 0, 0, 0 };
+    vec3<ushort> pBlockDim = { 0, 0, 0 };
+    uint numTags = 8;
+    double noise = 0.05;
+    double layerThickness = 6;
+    uint64_t seed = 1;
+    bool binary = false;
+    string outputPath;
+};
+
+static void printUsage()
+{
+    cerr << "usage: GenerateModel --volume X,Y,Z --parent X,Y,Z [--tags N] [--noise P] [--layer T] [--seed S] [--binary] [--output FILE]\n";
+}
+
+// parse "X,Y,Z", exits if any size is not between 1 and 'maxSize'
+static vec3<uint> parseSize(const char* text, unsigned long long maxSize)
+{
+    unsigned long long x = 0, y = 0, z = 0;
+    if (sscanf(text, "%llu,%llu,%llu", &x, &y, &z) != 3 || x == 0 || y == 0 || z == 0 || x > maxSize || y > maxSize || z > maxSize)
+    {
+        cerr << "sizes must be X,Y,Z with each between 1 and " << maxSize << ", not " << text << "\n";
+        exit(1);
+    }
+
+    return { (uint)x, (uint)y, (uint)z };
+}
+
+static Settings parseSettings(int argc, char* argv[])
+{
+    Settings settings;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+
+        if (arg == "--volume" && i + 1 < argc)
+            settings.volumeDim = parseSize(argv[++i], UINT32_MAX);
+        else if (arg == "--parent" && i + 1 < argc)
+            settings.pBlockDim = parseSize(argv[++i], UINT16_MAX).cast<ushort>();
+        else if (arg == "--tags" && i + 1 < argc)
+            settings.numTags = atoi(argv[++i]);
+        else if (arg == "--noise" && i + 1 < argc)
+            settings.noise = atof(argv[++i]);
+        else if (arg == "--layer" && i + 1 < argc)
+            settings.layerThickness = atof(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            settings.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--binary")
+            settings.binary = true;
+        else if (arg == "--output" && i + 1 < argc)
+            settings.outputPath = argv[++i];
+        else
+        {
+            printUsage();
+            exit(1);
+        }
+    }
+
+    if (settings.volumeDim.x == 0 || settings.pBlockDim.x == 0)
+    {
+        printUsage();
+        exit(1);
+    }
+
+    // parent blocks must tile the volume with no remainder
+    if (settings.volumeDim.x % settings.pBlockDim.x != 0 || settings.volumeDim.y % settings.pBlockDim.y != 0 || settings.volumeDim.z % settings.pBlockDim.z != 0)
+    {
+        cerr << "the volume must be a whole number of parent blocks on every axis\n";
+        exit(1);
+    }
+
+    if (settings.numTags < 1 || settings.numTags > 65536)
+    {
+        cerr << "--tags must be between 1 and 65536\n";
+        exit(1);
+    }
+
+    if (settings.noise < 0 || settings.noise > 1 || settings.layerThickness < 0)
+    {
+        cerr << "--noise must be between 0 and 1 and --layer must not be negative\n";
+        exit(1);
+    }
+
+    return settings;
+}
+
+// well mixed 64 bits from any input, so every voxel gets its own random number without keeping any state
+static uint64_t mix(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// tag names of varying length, like real models
+static string makeTagName(uint tag)
+{
+    static const char* names[] = { "air", "soil", "clay", "sandstone", "granite", "ore_high_grade", "water", "basalt" };
+    const uint numNames = sizeof(names) / sizeof(names[0]);
+
+    string name = names[tag % numNames];
+    if (tag >= numNames)
+    {
+        name += '_';
+        name += to_string(tag / numNames);
+    }
+
+    return name;
+}
+
+// generates the tag of each voxel of a row from the settings
+class ModelRows
+{
+private:
+    const Settings& settings;
+    double phaseX;
+    double phaseY;
+    double foldHeight;
+
+public:
+    ModelRows(const Settings& _settings) : settings(_settings)
+    {
+        // the folding of the layers is the only other thing the seed changes
+        uint64_t random = mix(settings.seed);
+        phaseX = (random & 0xFFFF) / 65536.0 * 6.283;
+        phaseY = (random >> 16 & 0xFFFF) / 65536.0 * 6.283;
+        foldHeight = settings.layerThickness * 1.5;
+    }
+
+    void fill(uint y, uint z, vector<ushort>& row) const
+    {
+        const uint64_t rowStart = ((uint64_t)z * settings.volumeDim.y + y) * settings.volumeDim.x;
+        const uint64_t noiseThreshold = (uint64_t)(settings.noise * 4294967296.0);
+
+        // with many tags noise only comes from the layers just above, so parent blocks keep few enough tags to compress
+        const bool manyTags = settings.numTags > 256;
+        const uint noiseTags = manyTags ? 16 : settings.numTags;
+
+        // with many tags each column of parent blocks has its layers offset by a random number of tags,
+        // so the whole range is used while a parent block only sees its own column's few layers
+        const uint columnY = y / settings.pBlockDim.y;
+        const uint numColumnsX = settings.volumeDim.x / settings.pBlockDim.x;
+        uint64_t columnOffset = 0;
+
+        for (uint x = 0; x < settings.volumeDim.x; x++)
+        {
+            if (manyTags && x % settings.pBlockDim.x == 0)
+                columnOffset = mix(settings.seed ^ mix((uint64_t)columnY * numColumnsX + x / settings.pBlockDim.x)) % settings.numTags;
+
+            uint layer = 0;
+            if (settings.layerThickness > 0)
+            {
+                double height = z + foldHeight * (sin(x * 0.03 + phaseX) + cos(y * 0.04 + phaseY));
+                layer = (uint)max(0.0, height / settings.layerThickness);
+            }
+
+            uint64_t random = mix(settings.seed ^ mix(rowStart + x));
+            bool isNoise = (random & 0xFFFFFFFF) < noiseThreshold;
+            uint64_t tag = isNoise ? (manyTags ? layer : 0) + (random >> 32) % noiseTags : layer;
+            if (manyTags)
+                tag += columnOffset;
+            row[x] = (ushort)(tag % settings.numTags);
+        }
+    }
+};
+
+// "x,y,z,1,1,1,'tag'" for every voxel of a row
+static void writeTextRow(uint y, uint z, const vector<ushort>& row, const vector<string>& quotedNames, vector<char>& text, FILE* output)
+{
+    // ",y,z" is at most 1 + 10 + 1 + 10 chars
+    char prefix[32];
+    char* prefixEnd = prefix;
+    *prefixEnd++ = ',';
+    to_chars_result result = to_chars(prefixEnd, prefix + sizeof(prefix), y);
+    if (result.ec == errc())
+    {
+        prefixEnd = result.ptr;
+        *prefixEnd++ = ',';
+        result = to_chars(prefixEnd, prefix + sizeof(prefix), z);
+    }
+    if (result.ec != errc())
+    {
+        cerr << "cannot format the position of row " << y << "," << z << "\n";
+        exit(2);
+    }
+    prefixEnd = result.ptr;
+    const size_t prefixLength = prefixEnd - prefix;
+
+    char* out = text.data();
+    for (uint x = 0; x < row.size(); x++)
+    {
+        out = to_chars(out, out + 10, x).ptr;
+        memcpy(out, prefix, prefixLength);
+        out += prefixLength;
+        memcpy(out, ",1,1,1,", 7);
+        out += 7;
+
+        const string& name = quotedNames[row[x]];
+        memcpy(out, name.data(), name.size());
+        out += name.size();
+    }
+
+    fwrite(text.data(), 1, out - text.data(), output);
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings = parseSettings(argc, argv);
+
+    FILE* output = stdout;
+    if (!settings.outputPath.empty())
+        output = fopen(settings.outputPath.c_str(), "wb");
+    if (output == nullptr)
+    {
+        cerr << "cannot write " << settings.outputPath << "\n";
+        return 2;
+    }
+
+    vector<string> quotedNames;
+    size_t longestName = 0;
+    for (uint tag = 0; tag < settings.numTags; tag++)
+    {
+        string quoted = makeTagName(tag);
+        quoted.insert(quoted.begin(), '\'');
+        quoted += "'\n";
+        quotedNames.push_back(quoted);
+        longestName = max(longestName, quotedNames.back().size());
+    }
+
+    const vec3<uint>& volumeDim = settings.volumeDim;
+    const vec3<ushort>& pBlockDim = settings.pBlockDim;
+
+    if (settings.binary)
+    {
+        // every tag is listed in the header, in ID order
+        WideTagTable tagTable;
+        for (uint tag = 0; tag < settings.numTags; tag++)
+            tagTable.getID(makeTagName(tag));
+
+        BlockWriter header;
+        VoxelFormat::writeHeader(header, volumeDim, pBlockDim, tagTable);
+        fwrite(header.data(), 1, header.size(), output);
+    }
+    else
+    {
+        fprintf(output, "%u,%u,%u,%u,%u,%u\n", volumeDim.x, volumeDim.y, volumeDim.z, pBlockDim.x, pBlockDim.y, pBlockDim.z);
+    }
+
+    // one row of IDs and its text is all that is ever held
+    ModelRows model(settings);
+    vector<ushort> row(volumeDim.x);
+    vector<char> text(settings.binary ? 0 : (size_t)volumeDim.x * (3 * 10 + 2 + 7 + longestName));
+
+    // binary IDs are little-endian ushorts only when a uchar cannot hold them
+    const size_t idBytes = VoxelFormat::needsWideIDs(settings.numTags) ? 2 : 1;
+    vector<uchar> bytes(settings.binary ? (size_t)volumeDim.x * idBytes : 0);
+
+    for (uint z = 0; z < volumeDim.z; z++)
+    {
+        for (uint y = 0; y < volumeDim.y; y++)
+        {
+            model.fill(y, z, row);
+
+            if (settings.binary)
+            {
+                for (size_t x = 0; x < row.size(); x++)
+                {
+                    bytes[x * idBytes] = (uchar)(row[x] & 0xFF);
+                    if (idBytes == 2)
+                        bytes[x * idBytes + 1] = (uchar)(row[x] >> 8);
+                }
+                fwrite(bytes.data(), 1, bytes.size(), output);
+            }
+            else
+                writeTextRow(y, z, row, quotedNames, text, output);
+        }
+    }
+
+    if (fflush(output) != 0 || ferror(output))
+    {
+        cerr << "writing the model failed\n";
+        return 2;
+    }
+
+    if (output != stdout)
+        fclose(output);
+
+    return 0;
+}
@@ -0,0 +1,528 @@
+// Checker of compressed output against the input it was made from
+// expands every block of the output back into voxels and checks that each voxel of the volume is covered
+// by exactly one block, that the block has the voxel's tag, and that no block crosses a parent block boundary
+// the input and output are both streamed a plane of parent blocks at a time, so memory use only depends on
+// the size of a plane; the next plane is read while the parent blocks of the last one are checked on every thread
+//
+// usage: VerifyOutput OUTPUT < input
+//   OUTPUT is text or binary output of BlockCompression, input is the text or binary voxel input it was made from
+//   tags are read with 16 bit IDs and positions with 32 bits so models of any size BlockCompression takes can be checked
+// exits with 0 if the output is correct, 3 if it is not, 1 for bad arguments and 2 if a file cannot be read
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BinaryFormat.h"
+#include "BlockingQueue.h"
+#include "LineParsing.h"
+#include "TagReader.h"
+#include "TagTable.h"
+#include "ThreadPool.h"
+#include "vec3.h"
+
+using namespace std;
+
+// problems are counted in full but only the first few are described
+#define MAX_REPORTED 10
+
+// block with its origin in the volume, converted to the IDs of the input's tag table
+struct Block
+{
+    vec3<uint> origin;
+    vec3<ushort> size;
+    ushort ID;
+};
+
+// everything needed to check one plane of parent blocks
+struct Slab
+{
+    uint plane;
+    vector<ushort> ids;                 // input tag ID of every voxel in the plane
+    vector<vector<Block>> pBlocks;      // output blocks of each parent block in the plane, row-major
+};
+
+class Problems
+{
+private:
+    mutex reportMutex;
+    uint numReported = 0;
+
+public:
+    atomic<unsigned long long> numOverlapping{ 0 };     // voxels covered by more than one block
+    atomic<unsigned long long> numUncovered{ 0 };       // voxels not covered by any block
+    atomic<unsigned long long> numWrongTag{ 0 };        // voxels covered by a block with a different tag
+    atomic<unsigned long long> numBadBlocks{ 0 };       // blocks crossing a boundary, outside the volume or out of order
+
+    void report(const string& message)
+    {
+        lock_guard<mutex> lock(reportMutex);
+        if (numReported++ < MAX_REPORTED)
+            cerr << message << "\n";
+    }
+
+    bool any() const
+    {
+        return numOverlapping + numUncovered + numWrongTag + numBadBlocks != 0;
+    }
+};
+
+static Problems problems;
+
+// "x,y,z" of a position
+template <typename T>
+static string describe(vec3<T> position)
+{
+    return position.to_string();
+}
+
+// "x,y,z,sizeX,sizeY,sizeZ" of a block
+static string describe(const Block& block)
+{
+    return describe(block.origin) + "," + describe(block.size);
+}
+
+// streams blocks from text or binary output, in the order they were written
+class OutputReader
+{
+private:
+    FILE* in;
+    vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool binary = false;
+    bool ended = false;                 // the end record of binary output has been read
+
+    vec3<ushort> pBlockDim;
+    WideTagTable& tagTable;
+    vector<ushort> binaryIDs;           // binary tag ID to the input's tag ID
+    vec3<uint> binaryPBlockOrigin;      // parent block the binary blocks being read are in
+    uint numBinaryBlocksLeft = 0;
+
+    // make sure 'length' bytes are buffered, false if the output ends first
+    bool fill(size_t length)
+    {
+        if (end - begin >= length)
+            return true;
+
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+
+        if (buffer.size() < length)
+            buffer.resize(length);
+
+        end += fread(buffer.data() + end, 1, buffer.size() - end, in);
+        return end - begin >= length;
+    }
+
+    void need(size_t length)
+    {
+        if (!fill(length))
+        {
+            cerr << "Output ended unexpectedly\n";
+            exit(2);
+        }
+    }
+
+    uchar readByte()
+    {
+        need(1);
+        return (uchar)buffer[begin++];
+    }
+
+    ushort readUShort()
+    {
+        need(2);
+        ushort value = (ushort)((uchar)buffer[begin] | (uchar)buffer[begin + 1] << 8);
+        begin += 2;
+        return value;
+    }
+
+    uint readUInt()
+    {
+        uint low = readUShort();
+        return low | (uint)readUShort() << 16;
+    }
+
+    bool nextText(Block& block)
+    {
+        // a whole line must be buffered, growing the buffer for lines longer than it
+        const char* newLine;
+        while ((newLine = (const char*)memchr(buffer.data() + begin, '\n', end - begin)) == nullptr)
+        {
+            // read as much as fits, or twice what is buffered if the line already fills the buffer
+            size_t buffered = end - begin;
+            if (!fill(max(buffered * 2, buffer.size())) && end - begin == buffered)
+            {
+                // the last line may have no line break
+                if (buffered == 0)
+                    return false;
+                newLine = buffer.data() + end;
+                break;
+            }
+        }
+
+        const char* line = buffer.data() + begin;
+        const char* lineEnd = newLine;
+        begin = min((size_t)(newLine - buffer.data()) + 1, end);
+
+        // positions can be 32 bit, sizes never exceed a parent block
+        unsigned long long numbers[6];
+        const char* c = line;
+        for (int i = 0; i < 6; i++)
+        {
+            if (!parseCoordinate(c, lineEnd, numbers[i]) || numbers[i] > (i < 3 ? UINT32_MAX : UINT16_MAX))
+            {
+                cerr << "Output has a line that is not a block: " << string(line, lineEnd - line) << "\n";
+                exit(2);
+            }
+        }
+
+        const char* open = (const char*)memchr(c, '\'', lineEnd - c);
+        const char* close = open == nullptr ? nullptr : (const char*)memchr(open + 1, '\'', lineEnd - open - 1);
+        if (close == nullptr)
+        {
+            cerr << "Output has a block without a tag: " << string(line, lineEnd - line) << "\n";
+            exit(2);
+        }
+
+        block.origin = { (uint)numbers[0], (uint)numbers[1], (uint)numbers[2] };
+        block.size = { (ushort)numbers[3], (ushort)numbers[4], (ushort)numbers[5] };
+        block.ID = tagTable.getID(string_view(open + 1, close - open - 1));
+        return true;
+    }
+
+    bool nextBinary(Block& block)
+    {
+        if (ended)
+            return false;
+
+        // skip over tag records and empty parent blocks to the next block
+        while (numBinaryBlocksLeft == 0)
+        {
+            const uchar type = readByte();
+
+            if (type == RECORD_TAGS)
+            {
+                const ushort firstID = readUShort();
+                const ushort count = readUShort();
+
+                binaryIDs.resize(max((size_t)(firstID + count), binaryIDs.size()));
+                for (ushort id = firstID; id < firstID + count; id++)
+                {
+                    const ushort length = readUShort();
+                    need(length);
+                    binaryIDs[id] = tagTable.getID(string_view(buffer.data() + begin, length));
+                    begin += length;
+                }
+            }
+            else if (type == RECORD_PARENT_BLOCK)
+            {
+                vec3<ushort> position;
+                position.x = readUShort();
+                position.y = readUShort();
+                position.z = readUShort();
+                binaryPBlockOrigin = (position * pBlockDim).cast<uint>();
+                numBinaryBlocksLeft = readUInt();
+            }
+            else if (type == RECORD_END)
+            {
+                ended = true;
+                return false;
+            }
+            else
+            {
+                cerr << "Unknown record in binary output\n";
+                exit(2);
+            }
+        }
+
+        vec3<ushort> origin;
+        origin.x = readUShort();
+        origin.y = readUShort();
+        origin.z = readUShort();
+        block.size.x = readUShort();
+        block.size.y = readUShort();
+        block.size.z = readUShort();
+        const uchar ID = readByte();
+        numBinaryBlocksLeft--;
+
+        if (ID >= binaryIDs.size())
+        {
+            cerr << "Binary output uses a tag before naming it\n";
+            exit(2);
+        }
+
+        // blocks of a binary parent block cannot reach outside it
+        if (origin.x + block.size.x > pBlockDim.x || origin.y + block.size.y > pBlockDim.y || origin.z + block.size.z > pBlockDim.z)
+            block.size = { 0, 0, 0 };
+
+        block.origin = binaryPBlockOrigin + origin.cast<uint>();
+        block.ID = binaryIDs[ID];
+        return true;
+    }
+
+public:
+    OutputReader(FILE* _in, vec3<uint> volumeDim, vec3<ushort> _pBlockDim, WideTagTable& _tagTable)
+        : in(_in), buffer(1048576), pBlockDim(_pBlockDim), tagTable(_tagTable)
+    {
+        binary = fill(4) && memcmp(buffer.data(), BINARY_MAGIC, 4) == 0;
+        if (!binary)
+            return;
+
+        begin += 4;
+        const ushort version = readUShort();
+        vec3<ushort> header[2];
+        for (vec3<ushort>& size : header)
+        {
+            size.x = readUShort();
+            size.y = readUShort();
+            size.z = readUShort();
+        }
+
+        if (version != BINARY_VERSION || !(header[0].cast<uint>() == volumeDim) || !(header[1] == pBlockDim))
+        {
+            cerr << "Binary output is a different version or size to the input\n";
+            exit(2);
+        }
+    }
+
+    // the next block, false at the end of the output
+    bool next(Block& block)
+    {
+        return binary ? nextBinary(block) : nextText(block);
+    }
+};
+
+// reads slabs of input and their blocks of output and hands them to the checker
+class SlabReader
+{
+private:
+    vec3<uint> volumeDim;
+    vec3<ushort> pBlockDim;
+    vec3<uint> numPBlocks;
+    WideTagTable tagTable;
+    OutputReader output;
+    Block pending;                      // first block of a later plane, read while looking for the end of a plane
+    bool hasPending;
+
+    // the pending block if there is one, otherwise the next block of the output
+    bool nextBlock(Block& block)
+    {
+        if (hasPending)
+        {
+            block = pending;
+            hasPending = false;
+            return true;
+        }
+
+        return output.next(block);
+    }
+
+    // parent block a block is in, or false if it is outside the volume or crosses a parent block boundary
+    bool findParentBlock(const Block& block, uint& pBlockIndex, uint& plane) const
+    {
+        const vec3<unsigned long long> o = block.origin.cast<unsigned long long>();
+        const vec3<ushort> s = block.size;
+        if (s.x == 0 || s.y == 0 || s.z == 0 || o.x + s.x > volumeDim.x || o.y + s.y > volumeDim.y || o.z + s.z > volumeDim.z)
+            return false;
+
+        // the first and last voxel must be in the same parent block
+        if (o.x / pBlockDim.x != (o.x + s.x - 1) / pBlockDim.x || o.y / pBlockDim.y != (o.y + s.y - 1) / pBlockDim.y || o.z / pBlockDim.z != (o.z + s.z - 1) / pBlockDim.z)
+            return false;
+
+        pBlockIndex = (uint)(o.x / pBlockDim.x + (o.y / pBlockDim.y) * numPBlocks.x);
+        plane = (uint)(o.z / pBlockDim.z);
+        return true;
+    }
+
+public:
+    SlabReader(vec3<uint> _volumeDim, vec3<ushort> _pBlockDim, FILE* outputFile)
+        : volumeDim(_volumeDim), pBlockDim(_pBlockDim), numPBlocks(volumeDim / pBlockDim.cast<uint>()),
+        output(outputFile, volumeDim, pBlockDim, tagTable), hasPending(false)
+    {
+    }
+
+    unique_ptr<Slab> read(uint plane)
+    {
+        auto slab = make_unique<Slab>();
+        slab->plane = plane;
+        slab->pBlocks.resize((size_t)numPBlocks.x * numPBlocks.y);
+
+        // IDs can come back inside the input rather than in the slab
+        slab->ids.resize((size_t)volumeDim.x * volumeDim.y * pBlockDim.z);
+        const ushort* ids = TagReader::readTagIDs(slab->ids.data(), slab->ids.size(), volumeDim, tagTable);
+        if (ids != slab->ids.data())
+            memcpy(slab->ids.data(), ids, slab->ids.size() * sizeof(ushort));
+
+        // planes are written in order, so this plane's blocks end at the first block of a later one
+        Block block;
+        while (nextBlock(block))
+        {
+            uint pBlockIndex;
+            uint blockPlane;
+            if (!findParentBlock(block, pBlockIndex, blockPlane))
+            {
+                problems.numBadBlocks++;
+                problems.report("block " + describe(block) + " is outside the volume or crosses a parent block boundary");
+                continue;
+            }
+
+            if (blockPlane > plane)
+            {
+                pending = block;
+                hasPending = true;
+                break;
+            }
+
+            if (blockPlane < plane)
+            {
+                problems.numBadBlocks++;
+                problems.report("block " + describe(block) + " comes after blocks of a later plane of parent blocks");
+                continue;
+            }
+
+            slab->pBlocks[pBlockIndex].push_back(block);
+        }
+
+        return slab;
+    }
+
+    // count any blocks left once every plane has been read
+    void finish()
+    {
+        Block block;
+        while (nextBlock(block))
+        {
+            problems.numBadBlocks++;
+            problems.report("block " + describe(block) + " is out of order");
+        }
+    }
+};
+
+// expand the blocks of one parent block over its voxels and check each voxel is covered once with the right tag
+static void checkParentBlock(const Slab& slab, uint pBlockIndex, vec3<uint> volumeDim, vec3<ushort> pBlockDim)
+{
+    const uint numPBlocksX = volumeDim.x / pBlockDim.x;
+    const vec3<uint> origin = { pBlockIndex % numPBlocksX * pBlockDim.x, pBlockIndex / numPBlocksX * pBlockDim.y, slab.plane * pBlockDim.z };
+    const size_t rowStride = volumeDim.x;
+    const size_t planeStride = (size_t)volumeDim.x * volumeDim.y;
+    const ushort* ids = slab.ids.data() + origin.x + origin.y * rowStride;
+
+    // how many blocks cover each voxel, saturating so overlaps are never mistaken for single cover
+    thread_local vector<uchar> coverage;
+    coverage.assign(pBlockDim.volume(), 0);
+    unsigned long long numOverlapping = 0, numWrongTag = 0;
+
+    for (const Block& block : slab.pBlocks[pBlockIndex])
+    {
+        const vec3<ushort> local = { (ushort)(block.origin.x - origin.x), (ushort)(block.origin.y - origin.y), (ushort)(block.origin.z - origin.z) };
+        unsigned long long blockWrongTag = 0;
+
+        for (ushort z = local.z; z < local.z + block.size.z; z++)
+        {
+            for (ushort y = local.y; y < local.y + block.size.y; y++)
+            {
+                const ushort* row = ids + z * planeStride + y * rowStride;
+                uchar* covered = coverage.data() + ((size_t)z * pBlockDim.y + y) * pBlockDim.x;
+
+                for (ushort x = local.x; x < local.x + block.size.x; x++)
+                {
+                    numOverlapping += covered[x] == 1;
+                    covered[x] = min(covered[x] + 1, 2);
+                    blockWrongTag += row[x] != block.ID;
+                }
+            }
+        }
+
+        if (blockWrongTag != 0)
+        {
+            numWrongTag += blockWrongTag;
+            problems.report("block " + describe(block) + " has the wrong tag for " + to_string(blockWrongTag) + " of its voxels");
+        }
+    }
+
+    unsigned long long numUncovered = count(coverage.begin(), coverage.end(), (uchar)0);
+
+    if (numOverlapping != 0)
+        problems.report("parent block at " + describe(origin) + " has " + to_string(numOverlapping) + " voxels covered more than once");
+    if (numUncovered != 0)
+        problems.report("parent block at " + describe(origin) + " has " + to_string(numUncovered) + " voxels not covered by any block");
+
+    problems.numOverlapping += numOverlapping;
+    problems.numUncovered += numUncovered;
+    problems.numWrongTag += numWrongTag;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 || argv[1][0] == '-')
+    {
+        cerr << "usage: VerifyOutput OUTPUT < input\n";
+        return 1;
+    }
+
+    FILE* outputFile = fopen(argv[1], "rb");
+    if (outputFile == nullptr)
+    {
+        cerr << "cannot read " << argv[1] << "\n";
+        return 2;
+    }
+
+    // volume description, read the same way as BlockCompression does
+    vec3<uint> volumeDim = { 0, 0, 0 };
+    vec3<ushort> pBlockDim = { 0, 0, 0 };
+    if (!TagReader::parseDescription(TagReader::setup(), volumeDim, pBlockDim) || pBlockDim.x == 0 || pBlockDim.y == 0 || pBlockDim.z == 0 || volumeDim.x % pBlockDim.x != 0 || volumeDim.y % pBlockDim.y != 0 || volumeDim.z % pBlockDim.z != 0)
+    {
+        cerr << "Input does not start with a volume made of whole parent blocks\n";
+        return 2;
+    }
+
+    const vec3<uint> numPBlocks = volumeDim / pBlockDim.cast<uint>();
+    SlabReader reader(volumeDim, pBlockDim, outputFile);
+
+    // reading the next slab overlaps checking the last, a slab waiting in the queue keeps memory to three slabs
+    BlockingQueue<unique_ptr<Slab>> slabs(1);
+    thread readThread([&]()
+    {
+        for (uint plane = 0; plane < numPBlocks.z; plane++)
+            slabs.push(reader.read(plane));
+        reader.finish();
+    });
+
+    ThreadPool& pool = ThreadPool::shared();
+    unsigned long long numBlocks = 0;
+
+    for (uint plane = 0; plane < numPBlocks.z; plane++)
+    {
+        unique_ptr<Slab> slab = slabs.pop();
+        for (const vector<Block>& blocks : slab->pBlocks)
+            numBlocks += blocks.size();
+
+        pool.parallelFor(slab->pBlocks.size(), [&](size_t pBlockIndex)
+        {
+            checkParentBlock(*slab, (uint)pBlockIndex, volumeDim, pBlockDim);
+        });
+    }
+
+    readThread.join();
+    fclose(outputFile);
+
+    if (problems.any())
+    {
+        cerr << "FAILED: " << problems.numOverlapping << " voxels covered more than once, " << problems.numUncovered << " not covered, "
+            << problems.numWrongTag << " with the wrong tag, " << problems.numBadBlocks << " blocks outside the volume, crossing parent blocks or out of order\n";
+        return 3;
+    }
+
+    cerr << "OK: " << numBlocks << " blocks cover all " << volumeDim.volume() << " voxels with the right tags\n";
+    return 0;
+}